@@ -0,0 +1,125 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/*
+  A linear allocator. Memory is taken from big blocks one after another and is
+  only given back all at once by `ResetArena` or `FreeArena`.
+*/
+
+#include "arena.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define AlignUp(x)                                                             \
+    (((x) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+#define BLOCK_HEADER_SIZE AlignUp(sizeof(ArenaBlock))
+
+ArenaBlock* CreateArenaBlock(size_t size) {
+    ArenaBlock* block = malloc(BLOCK_HEADER_SIZE + size);
+    if (!block) {
+        return NULL;
+    }
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+/*
+  Create an arena whose blocks are at least `block_size` bytes. Return `NULL`
+  if it cannot be allocated.
+*/
+Arena* CreateArena(size_t block_size) {
+    Arena* arena = calloc(1, sizeof(Arena));
+    if (!arena) {
+        return NULL;
+    }
+    arena->block_size = AlignUp(block_size);
+    arena->head = CreateArenaBlock(arena->block_size);
+    if (!arena->head) {
+        free(arena);
+        return NULL;
+    }
+    return arena;
+}
+
+void* ArenaAlloc(Arena* arena, size_t size) {
+    size = AlignUp(size);
+    ArenaBlock* block = arena->head;
+    if (!block || block->used + size > block->size) {
+        // the next block is at least twice the size of the previous one
+        size_t block_size = arena->block_size;
+        if (block && block->size * 2 > block_size) {
+            block_size = block->size * 2;
+        }
+        if (size > block_size) {
+            block_size = size;
+        }
+        ArenaBlock* new_block = CreateArenaBlock(block_size);
+        if (!new_block) {
+            return NULL;
+        }
+        new_block->next = block;
+        arena->head = block = new_block;
+    }
+    void* ptr = (uint8_t*)block + BLOCK_HEADER_SIZE + block->used;
+    block->used += size;
+    arena->total_used += size;
+    return ptr;
+}
+
+void* ArenaCalloc(Arena* arena, size_t count, size_t size) {
+    void* ptr = ArenaAlloc(arena, count * size);
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+/*
+  Give back all memory, but keep the biggest (newest) block for reuse.
+*/
+void ResetArena(Arena* arena) {
+    if (!arena->head) {
+        return;
+    }
+    ArenaBlock* next = NULL;
+    for (ArenaBlock* block = arena->head->next; block;) {
+        next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head->next = NULL;
+    arena->head->used = 0;
+    arena->total_used = 0;
+}
+
+void FreeArena(Arena* arena) {
+    ArenaBlock* next = NULL;
+    for (ArenaBlock* block = arena->head; block;) {
+        next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
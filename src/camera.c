@@ -0,0 +1,132 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "camera.h"
+#include "image/image.h"
+
+void InitCamera(Camera* camera, SDL_Rect bounds, int tile_height) {
+    *camera = (Camera){.bounds = bounds, .tile_height = tile_height};
+    camera->scale = 1;
+}
+
+/*
+  Compute everything which depends on the size of the view.
+*/
+void ResizeCamera(Camera* camera, int view_w, int view_h) {
+    camera->view_w = view_w;
+    camera->view_h = view_h;
+    camera->scale = 0.15 * view_h / camera->tile_height;
+    if (camera->scale < 1) {
+        camera->scale = 1;
+    }
+    camera->anchor = (Vector2f){view_w / 2.0, view_h / 1.5};
+}
+
+/*
+  Move the view to `focus`, keep it inside `bounds` and update the viewport.
+*/
+void PlaceCamera(Camera* camera) {
+    int scale = camera->scale;
+    SDL_Rect* bounds = &camera->bounds;
+    float max_x = -bounds->x * scale;
+    float max_y = -bounds->y * scale;
+    float min_x = camera->view_w - (bounds->x + bounds->w) * scale;
+    float min_y = camera->view_h - (bounds->y + bounds->h) * scale;
+    float x = camera->anchor.x - camera->focus.x * scale;
+    float y = camera->anchor.y - camera->focus.y * scale;
+    // a clamped camera looks at what is really shown, so the dead zone starts
+    // from there when the target turns back
+    if (x > max_x || x < min_x) {
+        x = x > max_x ? max_x : min_x;
+        camera->focus.x = (camera->anchor.x - x) / scale;
+    }
+    if (y > max_y || y < min_y) {
+        y = y > max_y ? max_y : min_y;
+        camera->focus.y = (camera->anchor.y - y) / scale;
+    }
+    camera->offset = (Vector2){SDL_floorf(x), SDL_floorf(y)};
+    int x0 = SDL_floorf((float)-camera->offset.x / scale);
+    int y0 = SDL_floorf((float)-camera->offset.y / scale);
+    int x1 = SDL_ceilf((float)(camera->view_w - camera->offset.x) / scale);
+    int y1 = SDL_ceilf((float)(camera->view_h - camera->offset.y) / scale);
+    camera->viewport = (SDL_Rect){x0, y0, x1 - x0, y1 - y0};
+}
+
+/*
+  Follow `target`, a point of the map, once per frame. The camera only moves
+  when the target leaves the dead zone around its focus.
+*/
+void FollowCamera(Camera* camera, Vector2f target) {
+    int view_w, view_h;
+    GetRenderViewSize(&view_w, &view_h);
+    if (view_w != camera->view_w || view_h != camera->view_h) {
+        ResizeCamera(camera, view_w, view_h);
+    }
+    if (!camera->is_following) {
+        camera->focus = target;
+        camera->is_following = 1;
+    }
+    if (target.x > camera->focus.x + CAMERA_DEAD_ZONE_X) {
+        camera->focus.x = target.x - CAMERA_DEAD_ZONE_X;
+    } else if (target.x < camera->focus.x - CAMERA_DEAD_ZONE_X) {
+        camera->focus.x = target.x + CAMERA_DEAD_ZONE_X;
+    }
+    if (target.y > camera->focus.y + CAMERA_DEAD_ZONE_Y) {
+        camera->focus.y = target.y - CAMERA_DEAD_ZONE_Y;
+    } else if (target.y < camera->focus.y - CAMERA_DEAD_ZONE_Y) {
+        camera->focus.y = target.y + CAMERA_DEAD_ZONE_Y;
+    }
+    PlaceCamera(camera);
+}
+
+/*
+  The viewport grown by `CAMERA_CULL_MARGIN`, in pixels of the map. Anything
+  outside of it does not need to be drawn.
+*/
+SDL_FRect GetVisibleRect(Camera* camera) {
+    return (SDL_FRect){
+        camera->viewport.x - CAMERA_CULL_MARGIN,
+        camera->viewport.y - CAMERA_CULL_MARGIN,
+        camera->viewport.w + 2 * CAMERA_CULL_MARGIN,
+        camera->viewport.h + 2 * CAMERA_CULL_MARGIN
+    };
+}
+
+int IsRectVisible(Camera* camera, const SDL_FRect* rect) {
+    SDL_FRect visible = GetVisibleRect(camera);
+    return SDL_HasIntersectionF(rect, &visible);
+}
+
+/*
+  The tiles of `bounds` which can be seen, for maps drawn tile by tile.
+*/
+SDL_Rect GetVisibleTiles(Camera* camera, int tile_w, int tile_h) {
+    SDL_Rect area;
+    if (!SDL_IntersectRect(&camera->viewport, &camera->bounds, &area)) {
+        return (SDL_Rect){0, 0, 0, 0};
+    }
+    int x0 = area.x / tile_w;
+    int y0 = area.y / tile_h;
+    int x1 = (area.x + area.w + tile_w - 1) / tile_w;
+    int y1 = (area.y + area.h + tile_h - 1) / tile_h;
+    return (SDL_Rect){x0, y0, x1 - x0, y1 - y0};
+}
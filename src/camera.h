@@ -0,0 +1,68 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef TH_CAMERA_H_
+#define TH_CAMERA_H_
+
+#include "global.h"
+#include <SDL.h>
+
+// the followed point may move this far from the focus of the camera before
+// the camera moves, in pixels of the map
+#define CAMERA_DEAD_ZONE_X 24
+#define CAMERA_DEAD_ZONE_Y 32
+// things are still drawn this far outside the view, for sprites which are
+// bigger than their bounding boxes
+#define CAMERA_CULL_MARGIN 32
+
+/*
+  What part of a map is drawn and where. The camera follows a point with a
+  dead zone and never shows anything outside `bounds`.
+
+  Scale, anchor and viewport only change with the size of the view, so they
+  are cached and computed again when it is resized.
+*/
+typedef struct Camera {
+    // the size of the map in pixels
+    SDL_Rect bounds;
+    // the height of a tile, the scale is chosen so that a few fit the view
+    int tile_height;
+    int view_w;
+    int view_h;
+    int scale;
+    // the point of the map drawn at `anchor` of the view
+    Vector2f focus;
+    Vector2f anchor;
+    int is_following;
+    // where the top left corner of the map is drawn
+    Vector2 offset;
+    // the visible part of the map in pixels of the map
+    SDL_Rect viewport;
+} Camera;
+
+void InitCamera(Camera* camera, SDL_Rect bounds, int tile_height);
+void FollowCamera(Camera* camera, Vector2f target);
+int IsRectVisible(Camera* camera, const SDL_FRect* rect);
+SDL_FRect GetVisibleRect(Camera* camera);
+SDL_Rect GetVisibleTiles(Camera* camera, int tile_w, int tile_h);
+
+#endif
@@ -21,12 +21,12 @@
 */
 
 #include "base.h"
+#include "../jobs.h"
 #include "../map.h"
 #include "player.h"
 #include <stdarg.h>
 #include <stdlib.h>
-
-#define GRAVITY_Y 240
+#include <string.h>
 
 void InitEntitySystem() {
     InitPlayerTexture();
@@ -36,37 +36,313 @@ void QuitEntitySystem() {
     FreePlayerTexture();
 }
 
-EntityList CreateEntityList() {
-    EntityListNode* node = calloc(1, sizeof(EntityListNode));
-    node->next = NULL;
-    return node;
+EntityStore* CreateEntityStore() {
+    EntityStore* store = calloc(1, sizeof(EntityStore));
+    store->slots.free_head = -1;
+    return store;
+}
+
+void FreeEntityStore(EntityStore* store) {
+    free(store->type);
+    free(store->status);
+    free(store->pos);
+    free(store->prev_pos);
+    free(store->velocity);
+    free(store->bbox);
+    free(store->activity);
+    free(store->animation);
+    free(store->data);
+    free(store->slot_of);
+    free(store->slots.index);
+    free(store->slots.generation);
+    free(store->removed.handles);
+    for (int i = 0; i < store->capacity / ENTITY_JOB_CHUNK; ++i) {
+        free(store->commands[i].commands);
+    }
+    free(store->commands);
+    FreeEntityGrid(&store->grid);
+    free(store);
+}
+
+void GrowEntityStore(EntityStore* store) {
+    int old_buffers = store->capacity / ENTITY_JOB_CHUNK;
+    store->capacity = store->capacity ? 2 * store->capacity : ENTITY_JOB_CHUNK;
+    int n = store->capacity;
+    store->type = realloc(store->type, n * sizeof(EntityType));
+    store->status = realloc(store->status, n * sizeof(EntityStatus));
+    store->pos = realloc(store->pos, n * sizeof(Vector2f));
+    store->prev_pos = realloc(store->prev_pos, n * sizeof(Vector2f));
+    store->velocity = realloc(store->velocity, n * sizeof(Vector2f));
+    store->bbox = realloc(store->bbox, n * sizeof(SDL_FRect));
+    store->activity = realloc(store->activity, n * sizeof(Uint8));
+    store->animation = realloc(store->animation, n * sizeof(AnimationPlayback));
+    store->data = realloc(store->data, n * sizeof(Entity));
+    store->slot_of = realloc(store->slot_of, n * sizeof(int));
+    int buffers = n / ENTITY_JOB_CHUNK;
+    store->commands =
+        realloc(store->commands, buffers * sizeof(EntityCommandBuffer));
+    memset(
+        &store->commands[old_buffers], 0,
+        (buffers - old_buffers) * sizeof(EntityCommandBuffer)
+    );
+}
+
+int AllocEntitySlot(EntityStore* store) {
+    if (store->slots.free_head < 0) {
+        int old = store->slots.capacity;
+        store->slots.capacity = old ? 2 * old : 16;
+        store->slots.index =
+            realloc(store->slots.index, store->slots.capacity * sizeof(int));
+        store->slots.generation = realloc(
+            store->slots.generation, store->slots.capacity * sizeof(Uint32)
+        );
+        for (int i = old; i < store->slots.capacity; ++i) {
+            store->slots.index[i] =
+                i + 1 < store->slots.capacity ? i + 1 : -1;
+            store->slots.generation[i] = 1;
+        }
+        store->slots.free_head = old;
+    }
+    int slot = store->slots.free_head;
+    store->slots.free_head = store->slots.index[slot];
+    return slot;
+}
+
+/*
+  Add a zeroed entity of `type` and return its handle. This may move the
+  arrays, so pointers into the store must not be kept across the call. Entity
+  logic must use `QueueSpawnEntity` instead.
+*/
+EntityHandle AddEntity(EntityStore* store, EntityType type, Map* map) {
+    if (store->count == store->capacity) {
+        GrowEntityStore(store);
+    }
+    int index = store->count++;
+    int slot = AllocEntitySlot(store);
+    store->slots.index[slot] = index;
+    store->slot_of[index] = slot;
+    EntityHandle handle = {slot, store->slots.generation[slot]};
+    store->type[index] = type;
+    store->status[index] = ENTITY_STATUS_IDLE;
+    store->pos[index] = (Vector2f){0, 0};
+    store->prev_pos[index] = (Vector2f){0, 0};
+    store->velocity[index] = (Vector2f){0, 0};
+    store->bbox[index] = (SDL_FRect){0, 0, 0, 0};
+    store->activity[index] = ENTITY_ACTIVITY_AWAKE;
+    InitAnimationPlayback(&store->animation[index], NULL);
+    store->data[index] = (Entity){0};
+    store->data[index].handle = handle;
+    store->data[index].map = map;
+    store->grid.is_dirty = 1;
+    return handle;
+}
+
+/*
+  Return the dense index of the entity, or -1 if it has been removed.
+*/
+int GetEntityIndex(EntityStore* store, EntityHandle handle) {
+    if (handle.slot < 0 || handle.slot >= store->slots.capacity ||
+        store->slots.generation[handle.slot] != handle.generation) {
+        return -1;
+    }
+    return store->slots.index[handle.slot];
+}
+
+/*
+  Queue the entity for removal. It stays in the store until the end of the
+  tick, so iterating over the store while removing is safe. Entity logic must
+  use `QueueRemoveEntity` instead.
+*/
+void RemoveEntity(EntityStore* store, EntityHandle handle) {
+    if (GetEntityIndex(store, handle) < 0) {
+        return;
+    }
+    if (store->removed.count == store->removed.capacity) {
+        store->removed.capacity =
+            store->removed.capacity ? 2 * store->removed.capacity : 8;
+        store->removed.handles = realloc(
+            store->removed.handles,
+            store->removed.capacity * sizeof(EntityHandle)
+        );
+    }
+    store->removed.handles[store->removed.count++] = handle;
+}
+
+/*
+  Free the queued entities and fill each hole with the last entity.
+*/
+void FlushRemovedEntities(EntityStore* store) {
+    if (store->removed.count > 0) {
+        store->grid.is_dirty = 1;
+    }
+    for (int i = 0; i < store->removed.count; ++i) {
+        EntityHandle handle = store->removed.handles[i];
+        int index = GetEntityIndex(store, handle);
+        if (index < 0) {
+            // queued twice
+            continue;
+        }
+        FreeEntity(store, index);
+        int last = --store->count;
+        if (index != last) {
+            store->type[index] = store->type[last];
+            store->status[index] = store->status[last];
+            store->pos[index] = store->pos[last];
+            store->prev_pos[index] = store->prev_pos[last];
+            store->velocity[index] = store->velocity[last];
+            store->bbox[index] = store->bbox[last];
+            store->activity[index] = store->activity[last];
+            store->animation[index] = store->animation[last];
+            store->data[index] = store->data[last];
+            store->slot_of[index] = store->slot_of[last];
+            store->slots.index[store->slot_of[index]] = index;
+        }
+        ++store->slots.generation[handle.slot];
+        if (store->slots.generation[handle.slot] == 0) {
+            store->slots.generation[handle.slot] = 1;
+        }
+        store->slots.index[handle.slot] = store->slots.free_head;
+        store->slots.free_head = handle.slot;
+    }
+    store->removed.count = 0;
+}
+
+EntityCommand* AddEntityCommand(EntityStore* store, int index) {
+    EntityCommandBuffer* buffer = &store->commands[index / ENTITY_JOB_CHUNK];
+    if (buffer->count == buffer->capacity) {
+        buffer->capacity = buffer->capacity ? 2 * buffer->capacity : 4;
+        buffer->commands = realloc(
+            buffer->commands, buffer->capacity * sizeof(EntityCommand)
+        );
+    }
+    return &buffer->commands[buffer->count++];
+}
+
+/*
+  Remove an entity from the logic of entity `index`, which may run in
+  parallel with other entities. It is removed at the end of the tick.
+*/
+void QueueRemoveEntity(EntityStore* store, int index, EntityHandle handle) {
+    EntityCommand* command = AddEntityCommand(store, index);
+    command->type = ENTITY_COMMAND_REMOVE;
+    command->handle = handle;
+}
+
+/*
+  Spawn an entity from the logic of entity `index`, it appears at the end of
+  the tick.
+*/
+void QueueSpawnEntity(
+    EntityStore* store, int index, EntityType type, float x, float y
+) {
+    EntityCommand* command = AddEntityCommand(store, index);
+    command->type = ENTITY_COMMAND_SPAWN;
+    command->spawn_type = type;
+    command->map = store->data[index].map;
+    command->pos = (Vector2f){x, y};
+}
+
+/*
+  Emit particles from the logic of entity `index`. The particles of a map are
+  shared, so they are emitted at the end of the tick too.
+*/
+void QueueParticleEffect(
+    EntityStore* store, int index, ParticleEffect effect, float x, float y
+) {
+    EntityCommand* command = AddEntityCommand(store, index);
+    command->type = ENTITY_COMMAND_EFFECT;
+    command->effect = effect;
+    command->map = store->data[index].map;
+    command->pos = (Vector2f){x, y};
+}
+
+/*
+  Apply the queued commands chunk by chunk, in the order they were queued.
+*/
+void ApplyEntityCommands(EntityStore* store) {
+    int buffers = (store->count + ENTITY_JOB_CHUNK - 1) / ENTITY_JOB_CHUNK;
+    for (int i = 0; i < buffers; ++i) {
+        // spawning may grow the store and move the buffers, so copy each
+        // command out before applying it
+        for (int j = 0; j < store->commands[i].count; ++j) {
+            EntityCommand command = store->commands[i].commands[j];
+            switch (command.type) {
+            case ENTITY_COMMAND_REMOVE:
+                RemoveEntity(store, command.handle);
+                break;
+            case ENTITY_COMMAND_SPAWN:
+                SpawnEntity(
+                    command.map, command.spawn_type, command.pos.x,
+                    command.pos.y
+                );
+                break;
+            case ENTITY_COMMAND_EFFECT:
+                EmitParticles(
+                    command.map->particles, command.effect, command.pos.x,
+                    command.pos.y
+                );
+                break;
+            }
+        }
+        store->commands[i].count = 0;
+    }
+}
+
+EntityHandle SpawnEntity(Map* map, EntityType type, float x, float y) {
+    switch (type) {
+    case ENTITY_TYPE_PLAYER:
+        return CreatePlayerEntity(map, x, y);
+    }
+    return (EntityHandle){0, 0};
 }
 
-void FreeEntityList(EntityList list) {
-    EntityListNode* next = NULL;
-    for (EntityListNode* node = list->next; node;) {
-        next = node->next;
-        free(node);
-        node = next;
+/*
+  Wake a resting entity. Call this after moving an entity other than through
+  its velocity.
+*/
+void WakeEntity(EntityStore* store, EntityHandle handle) {
+    int index = GetEntityIndex(store, handle);
+    if (index >= 0 && store->activity[index] == ENTITY_ACTIVITY_RESTING) {
+        store->activity[index] = ENTITY_ACTIVITY_AWAKE;
     }
+    store->grid.is_dirty = 1;
 }
 
-void AddEntityToList(EntityList list, Entity* entity) {
-    EntityListNode* node = calloc(1, sizeof(EntityListNode));
-    node->data = entity;
-    node->next = list->next;
-    list->next = node;
+/*
+  Wake the resting entities which touch `rect`, e.g. when the ground under it
+  changes.
+*/
+void WakeEntitiesInRect(EntityStore* store, SDL_FRect* rect) {
+    for (int i = 0; i < store->count; ++i) {
+        if (store->activity[i] != ENTITY_ACTIVITY_RESTING) {
+            continue;
+        }
+        Vector2f pos = store->pos[i];
+        SDL_FRect* size = &store->bbox[i];
+        if (pos.x + size->w >= rect->x && pos.x <= rect->x + rect->w &&
+            pos.y >= rect->y && pos.y - size->h <= rect->y + rect->h) {
+            store->activity[i] = ENTITY_ACTIVITY_AWAKE;
+        }
+    }
 }
 
-void RemoveEntityInList(EntityList list, Entity* entity) {
-    EntityListNode* prev = list->next;
-    for (EntityListNode* node = prev->next; node; node = node->next) {
-        if (node->data == entity) {
-            prev->next = node->next;
-            free(node);
-            return;
+/*
+  Put the entities outside the active region around the focus to sleep, and
+  wake those which entered it. Without a focus every entity is in the region.
+*/
+void UpdateEntityActivity(EntityStore* store) {
+    int focus = GetEntityIndex(store, store->focus);
+    Vector2f center = focus >= 0 ? store->pos[focus] : (Vector2f){0, 0};
+    for (int i = 0; i < store->count; ++i) {
+        int is_distant =
+            focus >= 0 &&
+            (SDL_fabsf(store->pos[i].x - center.x) > ENTITY_ACTIVE_RADIUS ||
+             SDL_fabsf(store->pos[i].y - center.y) > ENTITY_ACTIVE_RADIUS);
+        if (is_distant) {
+            store->activity[i] = ENTITY_ACTIVITY_DISTANT;
+        } else if (store->activity[i] == ENTITY_ACTIVITY_DISTANT) {
+            store->activity[i] = ENTITY_ACTIVITY_AWAKE;
         }
-        prev = node;
     }
 }
 
@@ -116,69 +392,209 @@ float GetGroundOrCeilingY(Map* map, float vy, SDL_FRect* bbox) {
     return bbox->y;
 }
 
-void TickEntityList(EntityList list, float dt) {
-    for (EntityListNode* node = list->next; node; node = node->next) {
-        if (node->data->should_delete) {
-            RemoveEntityInList(list, node->data);
+/*
+  Arguments of the parallel passes over the store.
+*/
+typedef struct EntityPass {
+    EntityStore* store;
+    float dt;
+} EntityPass;
+
+/*
+  The time step of entity `index` this tick. Distant entities are stepped once
+  every `ENTITY_DISTANT_TICK_INTERVAL` ticks, spread over the ticks by slot,
+  and make up for the skipped time. Return 0 if the entity skips this tick.
+*/
+float GetEntityStepTime(EntityStore* store, int index, float dt) {
+    if (store->activity[index] != ENTITY_ACTIVITY_DISTANT) {
+        return dt;
+    }
+    if ((store->tick + store->slot_of[index]) % ENTITY_DISTANT_TICK_INTERVAL) {
+        return 0;
+    }
+    return dt * ENTITY_DISTANT_TICK_INTERVAL;
+}
+
+/*
+  Apply gravity to entity `index` and move it by its velocity over `dt`,
+  stopping at the walls, ground and ceiling of its map. Collision is not
+  swept, so `dt` must be short enough not to skip over a tile.
+*/
+void StepEntityBody(EntityStore* store, int index, float dt) {
+    Entity* entity = &store->data[index];
+    Vector2f* pos = &store->pos[index];
+    Vector2f* velocity = &store->velocity[index];
+    SDL_FRect* size = &store->bbox[index];
+    SDL_FRect bbox = (SDL_FRect){pos->x, pos->y - size->h, size->w, size->h};
+    SDL_FRect test_bbox = bbox;
+    // simulate gravity and deal with collision
+    if (!entity->no_gravity_effect) {
+        Vector2f gravity = {0, GRAVITY_Y};
+        velocity->y += gravity.y * dt;
+    }
+    test_bbox.x += velocity->x * dt;
+    if (MapIsEmpty(entity->map, &test_bbox)) {
+        bbox.x = test_bbox.x;
+    } else {
+        bbox.x = GetWallX(entity->map, velocity->x, &test_bbox);
+        velocity->x *= -entity->elastic_collision_factor.x;
+        test_bbox.x = bbox.x;
+    }
+    test_bbox.y += velocity->y * dt;
+    if (MapIsEmpty(entity->map, &test_bbox)) {
+        bbox.y = test_bbox.y;
+    } else {
+        bbox.y = GetGroundOrCeilingY(entity->map, velocity->y, &test_bbox);
+        velocity->y *= -entity->elastic_collision_factor.y;
+    }
+    pos->x = bbox.x;
+    pos->y = bbox.y + size->h;
+}
+
+/*
+  Whether entity `index` stands still on the ground of its map.
+*/
+int IsEntityStanding(EntityStore* store, int index) {
+    Vector2f pos = store->pos[index];
+    SDL_FRect* size = &store->bbox[index];
+    if (store->velocity[index].x != 0 || store->velocity[index].y < 0) {
+        return 0;
+    }
+    return !MapIsEmpty(
+        store->data[index].map,
+        &(SDL_FRect){pos.x, pos.y - size->h + 1, size->w, size->h}
+    );
+}
+
+void StepEntityPhysicsJob(void* data, int begin, int end) {
+    EntityStore* store = ((EntityPass*)data)->store;
+    float pass_dt = ((EntityPass*)data)->dt;
+    for (int i = begin; i < end; ++i) {
+        Vector2f* velocity = &store->velocity[i];
+        float dt = GetEntityStepTime(store, i, pass_dt);
+        int steps = 1;
+        if (dt == 0) {
             continue;
+        } else if (store->activity[i] == ENTITY_ACTIVITY_RESTING) {
+            if (velocity->x == 0 && velocity->y == 0) {
+                continue;
+            }
+            store->activity[i] = ENTITY_ACTIVITY_AWAKE;
+        } else if (store->activity[i] == ENTITY_ACTIVITY_DISTANT) {
+            // the ground would cancel the gravity anyway
+            if (IsEntityStanding(store, i)) {
+                velocity->y = 0;
+                continue;
+            }
+            // make up for the skipped ticks one tick at a time, a single long
+            // step could pass through the ground
+            steps = ENTITY_DISTANT_TICK_INTERVAL;
+            dt = pass_dt;
         }
-        Entity* entity = node->data;
-        SDL_FRect bbox =
-            (SDL_FRect){entity->pos.x, entity->pos.y - entity->bbox.h,
-                        entity->bbox.w, entity->bbox.h};
-        SDL_FRect test_bbox = bbox;
-        // simulate gravity and deal with collision
-        if (!entity->no_gravity_effect) {
-            Vector2f gravity = {0, GRAVITY_Y};
-            entity->velocity.y += gravity.y * dt;
-        }
-        test_bbox.x += entity->velocity.x * dt;
-        if (MapIsEmpty(entity->map, &test_bbox)) {
-            bbox.x = test_bbox.x;
-        } else {
-            bbox.x = GetWallX(entity->map, entity->velocity.x, &test_bbox);
-            entity->velocity.x *= -entity->elastic_collision_factor.x;
-            test_bbox.x = bbox.x;
-        }
-        test_bbox.y += entity->velocity.y * dt;
-        if (MapIsEmpty(entity->map, &test_bbox)) {
-            bbox.y = test_bbox.y;
-        } else {
-            bbox.y = GetGroundOrCeilingY(
-                entity->map, entity->velocity.y, &test_bbox
-            );
-            entity->velocity.y *= -entity->elastic_collision_factor.y;
-        }
-        entity->pos.x = bbox.x;
-        entity->pos.y = bbox.y + entity->bbox.h;
-        switch (entity->type) {
-        case ENTITY_TYPE_PLAYER:
-            TickPlayer(entity, dt);
-            break;
+        for (int step = 0; step < steps; ++step) {
+            StepEntityBody(store, i, dt);
+        }
+        // gravity was cancelled by the ground and nothing else moves it
+        if (velocity->x == 0 && velocity->y == 0 &&
+            store->pos[i].x == store->prev_pos[i].x &&
+            store->pos[i].y == store->prev_pos[i].y) {
+            store->activity[i] = ENTITY_ACTIVITY_RESTING;
         }
     }
 }
 
-void HandleEntityEvent(EntityList list, SDL_Event* event) {
-    for (EntityListNode* node = list->next; node; node = node->next) {
-        if (node->data->event_handler) {
-            node->data->event_handler(node->data, event);
+/*
+  Apply gravity and resolve collisions with the map, as one sweep over the
+  packed arrays. A resting entity is skipped until its velocity is set, and a
+  distant one is stepped at the rate of its logic, in as many sub-steps as
+  the ticks it skipped. Entities only read the map and write their own
+  fields, so the sweep is split between the job workers.
+*/
+void StepEntityPhysics(EntityStore* store, float dt) {
+    memcpy(store->prev_pos, store->pos, store->count * sizeof(Vector2f));
+    store->grid.is_dirty = 1;
+    EntityPass pass = {store, dt};
+    ParallelFor(store->count, ENTITY_JOB_CHUNK, StepEntityPhysicsJob, &pass);
+}
+
+void TickEntityLogicJob(void* data, int begin, int end) {
+    EntityStore* store = ((EntityPass*)data)->store;
+    float dt = ((EntityPass*)data)->dt;
+    for (int i = begin; i < end; ++i) {
+        float entity_dt = GetEntityStepTime(store, i, dt);
+        if (entity_dt == 0) {
+            continue;
+        }
+        switch (store->type[i]) {
+        case ENTITY_TYPE_PLAYER:
+            TickPlayer(store, i, entity_dt);
+            break;
         }
     }
 }
 
-void FreeEntity(Entity* entity) {
-    switch (entity->type) {
+/*
+  Run the per-type logic of every entity in parallel. Logic may change its
+  own entity only, and must queue removals, spawns and particles with
+  `QueueRemoveEntity`, `QueueSpawnEntity` and `QueueParticleEffect`. Distant
+  entities run at the reduced rate of `GetEntityStepTime`.
+*/
+void TickEntityLogic(EntityStore* store, float dt) {
+    EntityPass pass = {store, dt};
+    ParallelFor(store->count, ENTITY_JOB_CHUNK, TickEntityLogicJob, &pass);
+    ++store->tick;
+}
+
+void UpdateEntityAnimationsJob(void* data, int begin, int end) {
+    EntityStore* store = ((EntityPass*)data)->store;
+    UpdateAnimations(
+        &store->animation[begin], end - begin, ((EntityPass*)data)->dt
+    );
+}
+
+/*
+  Advance the animations of all entities, the end callbacks may only change
+  their own entity.
+*/
+void UpdateEntityAnimations(EntityStore* store, float dt) {
+    EntityPass pass = {store, dt};
+    ParallelFor(
+        store->count, ENTITY_JOB_CHUNK, UpdateEntityAnimationsJob, &pass
+    );
+}
+
+/*
+  Prepare entities for drawing, `alpha` of a simulation step after the last
+  one.
+*/
+void InterpolateEntityStore(EntityStore* store, float alpha) {
+    store->alpha = alpha;
+}
+
+/*
+  Position of the entity between the last two simulation steps.
+*/
+Vector2f GetEntityDrawPos(EntityStore* store, int index) {
+    Vector2f prev = store->prev_pos[index];
+    Vector2f pos = store->pos[index];
+    return (Vector2f){
+        prev.x + (pos.x - prev.x) * store->alpha,
+        prev.y + (pos.y - prev.y) * store->alpha
+    };
+}
+
+void FreeEntity(EntityStore* store, int index) {
+    switch (store->type[index]) {
     case ENTITY_TYPE_PLAYER:
-        FreePlayerEntity(entity);
+        FreePlayerEntity(store, index);
         break;
     }
 }
 
-void DrawEntity(Entity* entity) {
-    switch (entity->type) {
+void DrawEntity(EntityStore* store, int index) {
+    switch (store->type[index]) {
     case ENTITY_TYPE_PLAYER:
-        DrawPlayerEntity(entity);
+        DrawPlayerEntity(store, index);
         break;
     }
 }
@@ -24,10 +24,22 @@
 #define TH_ENTITIES_BASE_H_
 
 #include "../global.h"
+#include "../image/image.h"
+#include "../particles.h"
+#include "broadphase.h"
 #include <SDL.h>
 
+#define GRAVITY_Y 240
+// half the size of the square around the focus in which entities are awake
+#define ENTITY_ACTIVE_RADIUS 640
+// entities outside the active region run their logic every this many ticks
+#define ENTITY_DISTANT_TICK_INTERVAL 8
+// entities handled by one job of a parallel pass, see `ParallelFor`
+#define ENTITY_JOB_CHUNK 64
+
 struct Map;
 typedef struct Map Map;
+struct EntityStore;
 
 typedef enum EntityType {
     ENTITY_TYPE_PLAYER
@@ -44,14 +56,65 @@ typedef enum EntityStatus {
     ENTITY_STATUS_HURT
 } EntityStatus;
 
-typedef struct Entity {
-    EntityType type;
-    EntityStatus status;
+/*
+  How much of the simulation an entity takes part in. A resting entity lies
+  still on solid ground and skips physics until something moves it. A distant
+  entity is outside the active region, its physics and logic run at a reduced
+  rate.
+*/
+typedef enum EntityActivity {
+    ENTITY_ACTIVITY_AWAKE,
+    ENTITY_ACTIVITY_RESTING,
+    ENTITY_ACTIVITY_DISTANT
+} EntityActivity;
+
+/*
+  A reference to an entity that stays valid across ticks. The slot may be
+  reused by another entity after removal, so the generation tells whether the
+  handle is stale. Generation 0 is never used, so a zeroed handle is null.
+*/
+typedef struct EntityHandle {
+    int slot;
+    Uint32 generation;
+} EntityHandle;
+
+typedef enum EntityCommandType {
+    ENTITY_COMMAND_REMOVE,
+    ENTITY_COMMAND_SPAWN,
+    ENTITY_COMMAND_EFFECT
+} EntityCommandType;
+
+typedef struct EntityCommand {
+    EntityCommandType type;
+    // the entity to remove
+    EntityHandle handle;
+    // the entity to spawn
+    EntityType spawn_type;
+    // the particles to emit
+    ParticleEffect effect;
+    Map* map;
     Vector2f pos;
+} EntityCommand;
+
+/*
+  Changes to shared state requested by entity logic, which runs in
+  parallel. Every `ENTITY_JOB_CHUNK` entities have a buffer of their own, and
+  the buffers are applied in order, so the outcome does not depend on which
+  thread ran what.
+*/
+typedef struct EntityCommandBuffer {
+    int count;
+    int capacity;
+    EntityCommand* commands;
+} EntityCommandBuffer;
+
+/*
+  Fields of an entity which are not touched by the physics sweep.
+*/
+typedef struct Entity {
+    EntityHandle handle;
     int no_gravity_effect;
-    Vector2f velocity;
     Vector2f elastic_collision_factor;
-    SDL_FRect bbox;
     int health;
     int damage;
     int is_attacking;
@@ -62,32 +125,88 @@ typedef struct Entity {
         float cooldown_time;
         float immortal_time;
     } take_damage;
-    int should_delete;
     Map* map;
-    void (*event_handler)(struct Entity*, SDL_Event*);
     void* userdata;
 } Entity;
 
-typedef struct EntityListNode {
-    Entity* data;
-    struct EntityListNode* next;
-} EntityListNode;
+/*
+  Entities packed into parallel arrays, indexed by a dense index in
+  `[0, count)`. Hot fields have arrays of their own so that the physics sweep
+  is linear; everything else lives in `data`.
 
-typedef EntityListNode* EntityList;
+  Removal swaps the last entity into the hole, so dense indices (and pointers
+  into the arrays) are only valid until the end of the tick. Keep an
+  `EntityHandle` to refer to an entity for longer.
+*/
+typedef struct EntityStore {
+    int count;
+    int capacity;
+    EntityType* type;
+    EntityStatus* status;
+    Vector2f* pos;
+    // position before the last simulation step, for render interpolation
+    Vector2f* prev_pos;
+    Vector2f* velocity;
+    SDL_FRect* bbox;
+    Uint8* activity;
+    // advanced together once per tick, by `UpdateAnimations`
+    AnimationPlayback* animation;
+    Entity* data;
+    // dense index -> slot
+    int* slot_of;
+    struct {
+        int capacity;
+        // slot -> dense index, or the next free slot if unused
+        int* index;
+        Uint32* generation;
+        int free_head;
+    } slots;
+    struct {
+        int count;
+        int capacity;
+        EntityHandle* handles;
+    } removed;
+    // one per `ENTITY_JOB_CHUNK` entities of the capacity
+    EntityCommandBuffer* commands;
+    // for queries between entities, see `broadphase.h`
+    EntityGrid grid;
+    // the entity the camera follows, the active region is centred on it
+    EntityHandle focus;
+    Uint32 tick;
+    // fraction of a simulation step elapsed since the last one, set by
+    // `InterpolateEntityStore`
+    float alpha;
+} EntityStore;
 
-#define ForEachEntity(element, list)                                           \
-    for (EntityListNode* element = list ? (list)->next : NULL; element;        \
-         element = (element)->next)
+#define ForEachEntity(index, store)                                            \
+    for (int index = 0; index < (store)->count; ++index)
 
 void InitEntitySystem();
 void QuitEntitySystem();
-EntityList CreateEntityList();
-void FreeEntityList(EntityList list);
-void AddEntityToList(EntityList list, Entity* entity);
-void RemoveEntityInList(EntityList list, Entity* entity);
-void TickEntityList(EntityList list, float dt);
-void HandleEntityEvent(EntityList list, SDL_Event* event);
-void FreeEntity(Entity* entity);
-void DrawEntity(Entity* entity);
+EntityStore* CreateEntityStore();
+void FreeEntityStore(EntityStore* store);
+EntityHandle AddEntity(EntityStore* store, EntityType type, Map* map);
+void RemoveEntity(EntityStore* store, EntityHandle handle);
+int GetEntityIndex(EntityStore* store, EntityHandle handle);
+void FlushRemovedEntities(EntityStore* store);
+void QueueRemoveEntity(EntityStore* store, int index, EntityHandle handle);
+void QueueSpawnEntity(
+    EntityStore* store, int index, EntityType type, float x, float y
+);
+void QueueParticleEffect(
+    EntityStore* store, int index, ParticleEffect effect, float x, float y
+);
+void ApplyEntityCommands(EntityStore* store);
+EntityHandle SpawnEntity(Map* map, EntityType type, float x, float y);
+void WakeEntity(EntityStore* store, EntityHandle handle);
+void WakeEntitiesInRect(EntityStore* store, SDL_FRect* rect);
+void UpdateEntityActivity(EntityStore* store);
+void StepEntityPhysics(EntityStore* store, float dt);
+void TickEntityLogic(EntityStore* store, float dt);
+void UpdateEntityAnimations(EntityStore* store, float dt);
+void InterpolateEntityStore(EntityStore* store, float alpha);
+Vector2f GetEntityDrawPos(EntityStore* store, int index);
+void FreeEntity(EntityStore* store, int index);
+void DrawEntity(EntityStore* store, int index);
 
 #endif
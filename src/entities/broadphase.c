@@ -0,0 +1,255 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/*
+  Broadphase for interactions between entities.
+
+  Entities are bucketed into a uniform grid with a counting sort, so a query
+  only tests the entities in the cells it touches instead of all of them.
+*/
+
+#include "broadphase.h"
+#include "base.h"
+#include <stdlib.h>
+#include <string.h>
+
+void FreeEntityGrid(EntityGrid* grid) {
+    free(grid->cell_start);
+    free(grid->entries);
+    free(grid->visited);
+    free(grid->results);
+    free(grid->hits);
+    memset(grid, 0, sizeof(EntityGrid));
+}
+
+/*
+  Bounding box of the entity in map coordinates.
+*/
+SDL_FRect GetEntityBox(EntityStore* store, int index) {
+    Vector2f pos = store->pos[index];
+    SDL_FRect* size = &store->bbox[index];
+    return (SDL_FRect){pos.x, pos.y - size->h, size->w, size->h};
+}
+
+/*
+  Hitbox of the entity in map coordinates, it is stored relative to the
+  position.
+*/
+SDL_FRect GetEntityHitbox(EntityStore* store, int index) {
+    Vector2f pos = store->pos[index];
+    SDL_FRect* hitbox = &store->data[index].hitbox;
+    return (SDL_FRect){
+        pos.x + hitbox->x, pos.y - hitbox->y, hitbox->w, hitbox->h
+    };
+}
+
+int RectsOverlap(SDL_FRect* a, SDL_FRect* b) {
+    return a->x < b->x + b->w && b->x < a->x + a->w && a->y < b->y + b->h &&
+           b->y < a->y + a->h;
+}
+
+void GetGridCellRange(
+    EntityGrid* grid, SDL_FRect* rect, int* x0, int* y0, int* x1, int* y1
+) {
+    *x0 = SDL_clamp(
+        (int)SDL_floorf((rect->x - grid->origin.x) / grid->cell_size), 0,
+        grid->width - 1
+    );
+    *y0 = SDL_clamp(
+        (int)SDL_floorf((rect->y - grid->origin.y) / grid->cell_size), 0,
+        grid->height - 1
+    );
+    *x1 = SDL_clamp(
+        (int)SDL_floorf((rect->x + rect->w - grid->origin.x) / grid->cell_size),
+        0, grid->width - 1
+    );
+    *y1 = SDL_clamp(
+        (int)SDL_floorf((rect->y + rect->h - grid->origin.y) / grid->cell_size),
+        0, grid->height - 1
+    );
+}
+
+void RebuildEntityGrid(EntityStore* store) {
+    EntityGrid* grid = &store->grid;
+    grid->is_dirty = 0;
+    if (store->count == 0) {
+        grid->width = grid->height = 0;
+        return;
+    }
+    // fit the grid to the area covered by entities
+    SDL_FRect box = GetEntityBox(store, 0);
+    float min_x = box.x, min_y = box.y;
+    float max_x = box.x + box.w, max_y = box.y + box.h;
+    for (int i = 1; i < store->count; ++i) {
+        box = GetEntityBox(store, i);
+        min_x = SDL_min(min_x, box.x);
+        min_y = SDL_min(min_y, box.y);
+        max_x = SDL_max(max_x, box.x + box.w);
+        max_y = SDL_max(max_y, box.y + box.h);
+    }
+    grid->origin = (Vector2f){min_x, min_y};
+    grid->cell_size = ENTITY_GRID_CELL_SIZE;
+    do {
+        grid->width = (int)((max_x - min_x) / grid->cell_size) + 1;
+        grid->height = (int)((max_y - min_y) / grid->cell_size) + 1;
+        grid->cell_size *= 2;
+    } while (grid->width * grid->height > ENTITY_GRID_MAX_CELLS);
+    grid->cell_size /= 2;
+    int cells = grid->width * grid->height;
+    if (grid->cell_capacity < cells + 1) {
+        grid->cell_capacity = cells + 1;
+        grid->cell_start =
+            realloc(grid->cell_start, grid->cell_capacity * sizeof(int));
+    }
+    // count the entries of every cell
+    memset(grid->cell_start, 0, (cells + 1) * sizeof(int));
+    int x0, y0, x1, y1;
+    for (int i = 0; i < store->count; ++i) {
+        box = GetEntityBox(store, i);
+        GetGridCellRange(grid, &box, &x0, &y0, &x1, &y1);
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                ++grid->cell_start[y * grid->width + x];
+            }
+        }
+    }
+    // turn the counts into the end of every cell, then fill the cells from
+    // the back so that each ends up at its start
+    int total = 0;
+    for (int c = 0; c < cells; ++c) {
+        total += grid->cell_start[c];
+        grid->cell_start[c] = total;
+    }
+    grid->cell_start[cells] = total;
+    if (grid->entry_capacity < total) {
+        grid->entry_capacity = total;
+        grid->entries = realloc(grid->entries, total * sizeof(int));
+    }
+    for (int i = 0; i < store->count; ++i) {
+        box = GetEntityBox(store, i);
+        GetGridCellRange(grid, &box, &x0, &y0, &x1, &y1);
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                grid->entries[--grid->cell_start[y * grid->width + x]] = i;
+            }
+        }
+    }
+    if (grid->visited_capacity < store->count) {
+        grid->visited_capacity = store->capacity;
+        grid->visited =
+            realloc(grid->visited, grid->visited_capacity * sizeof(Uint32));
+        memset(grid->visited, 0, grid->visited_capacity * sizeof(Uint32));
+        grid->visit_mark = 0;
+    }
+}
+
+/*
+  Start a new visit, so that every entity can be reported once more.
+*/
+void NextGridVisit(EntityGrid* grid) {
+    if (++grid->visit_mark == 0) {
+        memset(grid->visited, 0, grid->visited_capacity * sizeof(Uint32));
+        grid->visit_mark = 1;
+    }
+}
+
+/*
+  Put the entities whose bounding box overlaps `rect` into `results`, each
+  once, and return how many there are.
+*/
+int CollectEntitiesInRect(EntityStore* store, SDL_FRect* rect) {
+    EntityGrid* grid = &store->grid;
+    if (grid->is_dirty) {
+        RebuildEntityGrid(store);
+    }
+    if (store->count == 0) {
+        return 0;
+    }
+    int count = 0, x0, y0, x1, y1;
+    GetGridCellRange(grid, rect, &x0, &y0, &x1, &y1);
+    NextGridVisit(grid);
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            int c = y * grid->width + x;
+            for (int e = grid->cell_start[c]; e < grid->cell_start[c + 1];
+                 ++e) {
+                int index = grid->entries[e];
+                if (grid->visited[index] == grid->visit_mark) {
+                    continue;
+                }
+                grid->visited[index] = grid->visit_mark;
+                SDL_FRect box = GetEntityBox(store, index);
+                if (!RectsOverlap(&box, rect)) {
+                    continue;
+                }
+                if (count == grid->result_capacity) {
+                    grid->result_capacity =
+                        grid->result_capacity ? 2 * grid->result_capacity : 16;
+                    grid->results = realloc(
+                        grid->results, grid->result_capacity * sizeof(int)
+                    );
+                }
+                grid->results[count++] = index;
+            }
+        }
+    }
+    return count;
+}
+
+/*
+  Return the indices of the entities whose bounding box overlaps `rect`. The
+  array belongs to the store and is valid until the next query.
+*/
+int* QueryEntitiesInRect(EntityStore* store, SDL_FRect* rect, int* count) {
+    *count = CollectEntitiesInRect(store, rect);
+    return store->grid.results;
+}
+
+/*
+  Return every pair of an attacking entity and another entity its hitbox
+  overlaps. The array belongs to the store and is valid until the next query.
+*/
+EntityHit* QueryEntityHits(EntityStore* store, int* count) {
+    EntityGrid* grid = &store->grid;
+    *count = 0;
+    for (int i = 0; i < store->count; ++i) {
+        if (!store->data[i].is_attacking) {
+            continue;
+        }
+        SDL_FRect hitbox = GetEntityHitbox(store, i);
+        int n = CollectEntitiesInRect(store, &hitbox);
+        for (int j = 0; j < n; ++j) {
+            if (grid->results[j] == i) {
+                continue;
+            }
+            if (*count == grid->hit_capacity) {
+                grid->hit_capacity =
+                    grid->hit_capacity ? 2 * grid->hit_capacity : 16;
+                grid->hits = realloc(
+                    grid->hits, grid->hit_capacity * sizeof(EntityHit)
+                );
+            }
+            grid->hits[(*count)++] = (EntityHit){i, grid->results[j]};
+        }
+    }
+    return grid->hits;
+}
@@ -0,0 +1,79 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef TH_ENTITIES_BROADPHASE_H_
+#define TH_ENTITIES_BROADPHASE_H_
+
+#include "../global.h"
+#include <SDL.h>
+
+// side of a grid cell in pixels, about the size of a character
+#define ENTITY_GRID_CELL_SIZE 64
+// the cells get bigger when entities are spread wider than this
+#define ENTITY_GRID_MAX_CELLS 16384
+
+struct EntityStore;
+
+/*
+  An attacking entity whose hitbox overlaps the bounding box of `target`.
+*/
+typedef struct EntityHit {
+    int attacker;
+    int target;
+} EntityHit;
+
+/*
+  Uniform grid over the bounding boxes of all entities, stored as entity
+  indices sorted by cell. It covers the area the entities occupy and is
+  built again on the first query after anything moved.
+*/
+typedef struct EntityGrid {
+    int is_dirty;
+    float cell_size;
+    Vector2f origin;
+    int width;
+    int height;
+    // entries of cell `c` are `entries[cell_start[c]..cell_start[c + 1]]`
+    int* cell_start;
+    int cell_capacity;
+    int* entries;
+    int entry_capacity;
+    // an entity in several cells is reported once per query
+    Uint32* visited;
+    int visited_capacity;
+    Uint32 visit_mark;
+    // query results, valid until the next query
+    int* results;
+    int result_capacity;
+    EntityHit* hits;
+    int hit_capacity;
+} EntityGrid;
+
+void FreeEntityGrid(EntityGrid* grid);
+SDL_FRect GetEntityBox(struct EntityStore* store, int index);
+SDL_FRect GetEntityHitbox(struct EntityStore* store, int index);
+int* QueryEntitiesInRect(
+    struct EntityStore* store, SDL_FRect* rect, int* count
+);
+EntityHit* QueryEntityHits(struct EntityStore* store, int* count);
+
+#endif
@@ -22,14 +22,15 @@
 
 #include "player.h"
 #include "../image/image.h"
+#include "../input.h"
 #include "../map.h"
 #include "../resource/loader.h"
 #include <assert.h>
 
-#define PLAYER_RUN_VELOCITY 120
-#define PLAYER_JUMP_VELOCITY (-150)
 #define CaptainImageGrid(x, y) RectFromImageGrid(504, 320, 8, 9, x, y)
 
+extern GameApp game_app;
+
 SDL_Texture* captain_texture = NULL;
 SDL_Rect idle_with_sword_animation_clip[] = {
     CaptainImageGrid(2, 3), CaptainImageGrid(3, 3), CaptainImageGrid(4, 3),
@@ -77,11 +78,12 @@ SDL_Rect ground_without_sword_texture_rect[] = {
     CaptainImageGrid(6, 1), CaptainImageGrid(7, 1)
 };
 
-int is_attack_key_pressed = 0;
-int is_jump_key_pressed = 0;
-
 void InitPlayerTexture() {
-    captain_texture = LoadTexture("images/characters/captain.png");
+    // headless mode has no renderer, but the animations still time the
+    // attacks
+    if (game_app.renderer) {
+        captain_texture = LoadTexture("images/characters/captain.png");
+    }
     idle_with_sword_animation = CreateAnimation(
         captain_texture, 0.1, idle_with_sword_animation_clip,
         SDL_arraysize(idle_with_sword_animation_clip)
@@ -113,7 +115,10 @@ void InitPlayerTexture() {
 }
 
 void FreePlayerTexture() {
-    SDL_DestroyTexture(captain_texture);
+    if (captain_texture) {
+        SDL_DestroyTexture(captain_texture);
+        captain_texture = NULL;
+    }
     FreeAnimation(idle_with_sword_animation);
     FreeAnimation(run_with_sword_animation);
     FreeAnimation(attack_with_seord_animation_list[0]);
@@ -123,142 +128,148 @@ void FreePlayerTexture() {
     FreeAnimation(run_without_sword_animation);
 }
 
-Entity* CreatePlayerEntity(Map* map, float x, float y) {
-    Entity* player = calloc(1, sizeof(Entity));
-    player->type = ENTITY_TYPE_PLAYER;
-    player->status = ENTITY_STATUS_IDLE;
-    player->pos = (Vector2f){x, y};
-    player->velocity = (Vector2f){0, 0};
+EntityHandle CreatePlayerEntity(Map* map, float x, float y) {
+    EntityStore* store = map->entities;
+    EntityHandle handle = AddEntity(store, ENTITY_TYPE_PLAYER, map);
+    int index = GetEntityIndex(store, handle);
+    Entity* player = &store->data[index];
+    store->status[index] = ENTITY_STATUS_IDLE;
+    store->pos[index] = (Vector2f){x, y};
+    store->prev_pos[index] = (Vector2f){x, y};
+    store->velocity[index] = (Vector2f){0, 0};
+    store->bbox[index] = (SDL_FRect){16, 4, 16, 28};
     player->no_gravity_effect = 0;
     player->elastic_collision_factor = (Vector2f){0, 0};
-    player->bbox = (SDL_FRect){16, 4, 16, 28};
     player->hitbox = (SDL_FRect){24, 11, 15, 7};
-    player->map = map;
-    player->event_handler = HandlePlayerEvent;
     PlayerUserData* data = calloc(1, sizeof(PlayerUserData));
+    data->handle = handle;
+    data->map = map;
     data->facing_right = 1;
     data->with_sword = 1;
-    data->running_direction = 0;
     data->ground_cooldown_time = 0;
+    InitAnimationPlayback(&store->animation[index], idle_with_sword_animation);
+    store->animation[index].userdata = data;
+    store->animation[index].on_animation_end = OnPlayerAnimationEnd;
     player->userdata = data;
-    attack_with_seord_animation_list[0]->userdata = player;
-    attack_with_seord_animation_list[0]->on_animation_end =
-        OnPlayerAttackAnimationEnd;
-    attack_with_seord_animation_list[1]->userdata = player;
-    attack_with_seord_animation_list[1]->on_animation_end =
-        OnPlayerAttackAnimationEnd;
-    attack_with_seord_animation_list[2]->userdata = player;
-    attack_with_seord_animation_list[2]->on_animation_end =
-        OnPlayerAttackAnimationEnd;
-    return player;
+    return handle;
 }
 
-void OnPlayerAttackAnimationEnd(void* userdata, Animation* anim) {
-    Entity* player = (Entity*)userdata;
-    assert(player->type == ENTITY_TYPE_PLAYER);
-    PlayerUserData* data = (PlayerUserData*)player->userdata;
-    if (player->velocity.x != 0) {
-        player->status = ENTITY_STATUS_RUN;
+/*
+  Looping animations end too, only the end of an attack changes the status.
+*/
+void OnPlayerAnimationEnd(void* userdata, AnimationPlayback* playback) {
+    PlayerUserData* data = (PlayerUserData*)userdata;
+    EntityStore* store = data->map->entities;
+    int index = GetEntityIndex(store, data->handle);
+    if (index < 0 || store->status[index] != ENTITY_STATUS_ATTACK) {
+        return;
+    }
+    assert(store->type[index] == ENTITY_TYPE_PLAYER);
+    Entity* player = &store->data[index];
+    if (store->velocity[index].x != 0) {
+        store->status[index] = ENTITY_STATUS_RUN;
     } else {
-        player->status = ENTITY_STATUS_IDLE;
+        store->status[index] = ENTITY_STATUS_IDLE;
     }
     player->is_attacking = 0;
     data->last_attack_time = 0.5;
 }
 
-void TickPlayer(Entity* player, float dt) {
-    assert(player->type == ENTITY_TYPE_PLAYER);
-    PlayerUserData* data = (PlayerUserData*)player->userdata;
-    // set map drawing offset
-    int win_w, win_h;
-    SDL_GetWindowSize(game_app.window, &win_w, &win_h);
-    Map* map = player->map;
-    map->draw_scale = 0.15 * win_h / map->tilemap->tileheight;
-    if (map->draw_scale < 1) {
-        map->draw_scale = 1;
+/*
+  Return the animation for `status`, or NULL if the status shows a still
+  frame which depends on the velocity instead.
+*/
+Animation* GetPlayerAnimation(PlayerUserData* data, EntityStatus status) {
+    switch (status) {
+    case ENTITY_STATUS_IDLE:
+        return data->with_sword ? idle_with_sword_animation
+                                : idle_without_sword_animation;
+    case ENTITY_STATUS_RUN:
+        return data->with_sword ? run_with_sword_animation
+                                : run_without_sword_animation;
+    case ENTITY_STATUS_ATTACK:
+        return attack_with_seord_animation_list[data->attack_variant];
+    default:
+        return NULL;
     }
-    map->draw_offset.x = win_w / 2.0 - player->pos.x * map->draw_scale;
-    player->map->draw_offset.y = win_h / 1.5 - player->pos.y * map->draw_scale;
-    if (map->draw_offset.x > 0) {
-        map->draw_offset.x = 0;
-    } else if (map->draw_offset.x < win_w - map->tilemap->width *
-                                                map->tilemap->tilewidth *
-                                                map->draw_scale) {
-        map->draw_offset.x = win_w - map->tilemap->width *
-                                         map->tilemap->tilewidth *
-                                         map->draw_scale;
+}
+
+void TickPlayer(EntityStore* store, int index, float dt) {
+    assert(store->type[index] == ENTITY_TYPE_PLAYER);
+    Entity* player = &store->data[index];
+    EntityStatus* status = &store->status[index];
+    Vector2f* velocity = &store->velocity[index];
+    SDL_FRect* bbox = &store->bbox[index];
+    PlayerUserData* data = (PlayerUserData*)player->userdata;
+    InputState* input = &input_system.state;
+    if (input->pressed & INPUT_ACTION_BIT(INPUT_ACTION_JUMP)) {
+        if (*status != ENTITY_STATUS_JUMP && *status != ENTITY_STATUS_FALL) {
+            *status = ENTITY_STATUS_JUMP;
+            velocity->y = PLAYER_JUMP_VELOCITY;
+        }
     }
-    if (map->draw_offset.y > 0) {
-        map->draw_offset.y = 0;
-    } else if (map->draw_offset.y < win_h - map->tilemap->height *
-                                                map->tilemap->tileheight *
-                                                map->draw_scale) {
-        map->draw_offset.y = win_h - map->tilemap->height *
-                                         map->tilemap->tileheight *
-                                         map->draw_scale;
+    if (input->pressed & INPUT_ACTION_BIT(INPUT_ACTION_ATTACK)) {
+        if (*status != ENTITY_STATUS_ATTACK && *status != ENTITY_STATUS_JUMP &&
+            *status != ENTITY_STATUS_FALL) {
+            *status = ENTITY_STATUS_ATTACK;
+            player->is_attacking = 1;
+            if (data->last_attack_time > 0) {
+                ++data->attack_variant;
+                if (data->attack_variant == 3) {
+                    data->attack_variant = 0;
+                }
+            }
+            if (data->last_attack_time < 0) {
+                data->attack_variant = 0;
+            }
+        }
     }
     // set status according to velocity
-    if (player->velocity.y >= 0.5) {
-        player->status = ENTITY_STATUS_FALL;
+    if (velocity->y >= 0.5) {
+        *status = ENTITY_STATUS_FALL;
         player->is_attacking = 0;
     }
-    if (player->status == ENTITY_STATUS_GROUND) {
+    if (*status == ENTITY_STATUS_GROUND) {
         data->ground_cooldown_time -= dt;
         if (data->ground_cooldown_time <= 0) {
-            player->status = ENTITY_STATUS_IDLE;
+            *status = ENTITY_STATUS_IDLE;
         }
     }
-    if (player->velocity.y == 0 && player->status == ENTITY_STATUS_FALL) {
-        player->status = ENTITY_STATUS_GROUND;
+    if (velocity->y == 0 && *status == ENTITY_STATUS_FALL) {
+        *status = ENTITY_STATUS_GROUND;
         data->ground_cooldown_time = 0.12;
+        Vector2f* pos = &store->pos[index];
+        QueueParticleEffect(
+            store, index, PARTICLE_EFFECT_DUST, pos->x + bbox->w / 2, pos->y
+        );
     }
     // change attack variants
     if (data->last_attack_time >= 0) {
         data->last_attack_time -= dt;
     }
-    int left = data->running_direction == 1;
-    int right = data->running_direction == 2;
-    if (game_app.joystick.available) {
-        left = left || SDL_GameControllerGetAxis(
-                           game_app.joystick.device, SDL_CONTROLLER_AXIS_LEFTX
-                       ) < -16384;
-        left = left ||
-               SDL_GameControllerGetButton(
-                   game_app.joystick.device, SDL_CONTROLLER_BUTTON_DPAD_LEFT
-               );
-        right = right || SDL_GameControllerGetAxis(
-                             game_app.joystick.device, SDL_CONTROLLER_AXIS_LEFTX
-                         ) > 16384;
-        right = right ||
-                SDL_GameControllerGetButton(
-                    game_app.joystick.device, SDL_CONTROLLER_BUTTON_DPAD_RIGHT
-                );
-    }
-    if (left && right) {
-        // do nothing
-    } else if (left) {
-        if (player->status == ENTITY_STATUS_IDLE &&
-            player->status != ENTITY_STATUS_GROUND &&
-            player->status != ENTITY_STATUS_ATTACK) {
-            player->status = ENTITY_STATUS_RUN;
+    if (input->move_x < 0) {
+        if (*status == ENTITY_STATUS_IDLE &&
+            *status != ENTITY_STATUS_GROUND &&
+            *status != ENTITY_STATUS_ATTACK) {
+            *status = ENTITY_STATUS_RUN;
         }
-        player->bbox = (SDL_FRect){24, 4, 16, 28};
-        player->velocity.x = -PLAYER_RUN_VELOCITY;
+        *bbox = (SDL_FRect){24, 4, 16, 28};
+        velocity->x = input->move_x * PLAYER_RUN_VELOCITY;
         data->facing_right = 0;
-    } else if (right) {
-        if (player->status == ENTITY_STATUS_IDLE &&
-            player->status != ENTITY_STATUS_GROUND &&
-            player->status != ENTITY_STATUS_ATTACK) {
-            player->status = ENTITY_STATUS_RUN;
+    } else if (input->move_x > 0) {
+        if (*status == ENTITY_STATUS_IDLE &&
+            *status != ENTITY_STATUS_GROUND &&
+            *status != ENTITY_STATUS_ATTACK) {
+            *status = ENTITY_STATUS_RUN;
         }
-        player->bbox = (SDL_FRect){16, 4, 16, 28};
-        player->velocity.x = PLAYER_RUN_VELOCITY;
+        *bbox = (SDL_FRect){16, 4, 16, 28};
+        velocity->x = input->move_x * PLAYER_RUN_VELOCITY;
         data->facing_right = 1;
     } else {
-        if (player->status == ENTITY_STATUS_RUN) {
-            player->status = ENTITY_STATUS_IDLE;
+        if (*status == ENTITY_STATUS_RUN) {
+            *status = ENTITY_STATUS_IDLE;
         }
-        player->velocity.x = 0;
+        velocity->x = 0;
     }
     if (data->facing_right) {
         if (data->attack_variant == 0) {
@@ -273,152 +284,73 @@ void TickPlayer(Entity* player, float dt) {
             player->hitbox = (SDL_FRect){-20, 19, 9, 26};
         }
     }
+    SetPlaybackAnimation(
+        &store->animation[index], GetPlayerAnimation(data, *status)
+    );
 }
 
-void HandlePlayerEvent(Entity* player, SDL_Event* event) {
-    assert(player->type == ENTITY_TYPE_PLAYER);
-    PlayerUserData* data = (PlayerUserData*)player->userdata;
-    switch (event->type) {
-    case SDL_KEYDOWN:
-        if (event->key.keysym.sym == SDLK_LEFT) {
-            data->running_direction = 1;
-        } else if (event->key.keysym.sym == SDLK_RIGHT) {
-            data->running_direction = 2;
-        } else if (event->key.keysym.sym == SDLK_x) {
-            if (player->status != ENTITY_STATUS_JUMP &&
-                player->status != ENTITY_STATUS_FALL && !is_jump_key_pressed) {
-                player->status = ENTITY_STATUS_JUMP;
-                player->velocity.y = PLAYER_JUMP_VELOCITY;
-                is_jump_key_pressed = 1;
-            }
-        } else if (event->key.keysym.sym == SDLK_z) {
-            if (player->status != ENTITY_STATUS_ATTACK &&
-                player->status != ENTITY_STATUS_JUMP &&
-                player->status != ENTITY_STATUS_FALL &&
-                !is_attack_key_pressed) {
-                player->status = ENTITY_STATUS_ATTACK;
-                player->is_attacking = 1;
-                is_attack_key_pressed = 1;
-                if (data->last_attack_time > 0) {
-                    ++data->attack_variant;
-                    if (data->attack_variant == 3) {
-                        data->attack_variant = 0;
-                    }
-                }
-                if (data->last_attack_time < 0) {
-                    data->attack_variant = 0;
-                }
-            }
-        }
-        break;
-    case SDL_KEYUP:
-        if (event->key.keysym.sym == SDLK_LEFT ||
-            event->key.keysym.sym == SDLK_RIGHT) {
-            data->running_direction = 0;
-        } else if (event->key.keysym.sym == SDLK_x) {
-            is_jump_key_pressed = 0;
-        } else if (event->key.keysym.sym == SDLK_z) {
-            is_attack_key_pressed = 0;
-        }
-        break;
-    case SDL_CONTROLLERBUTTONDOWN:
-        if (event->cbutton.button == SDL_CONTROLLER_BUTTON_A) {
-            if (player->status != ENTITY_STATUS_JUMP &&
-                player->status != ENTITY_STATUS_FALL) {
-                player->status = ENTITY_STATUS_JUMP;
-                player->velocity.y = PLAYER_JUMP_VELOCITY;
-            }
-        } else if (event->cbutton.button == SDL_CONTROLLER_BUTTON_X) {
-            if (player->status != ENTITY_STATUS_ATTACK &&
-                player->status != ENTITY_STATUS_JUMP &&
-                player->status != ENTITY_STATUS_FALL) {
-                player->status = ENTITY_STATUS_ATTACK;
-                player->is_attacking = 1;
-                if (data->last_attack_time > 0) {
-                    ++data->attack_variant;
-                    if (data->attack_variant == 3) {
-                        data->attack_variant = 0;
-                    }
-                }
-                if (data->last_attack_time < 0) {
-                    data->attack_variant = 0;
-                }
-            }
-        }
-    }
-}
-
-void DrawPlayerEntity(Entity* player) {
-    assert(player->type == ENTITY_TYPE_PLAYER);
+void DrawPlayerEntity(EntityStore* store, int index) {
+    assert(store->type[index] == ENTITY_TYPE_PLAYER);
+    Entity* player = &store->data[index];
+    EntityStatus* status = &store->status[index];
+    // drawn between the last two simulation steps
+    Vector2f pos = GetEntityDrawPos(store, index);
+    Vector2f* velocity = &store->velocity[index];
+    SDL_FRect* bbox = &store->bbox[index];
     PlayerUserData* data = (PlayerUserData*)player->userdata;
-    int scale = player->map->draw_scale;
-    int x = player->pos.x * scale + player->map->draw_offset.x -
-            player->bbox.x * scale;
-    int y = player->pos.y * scale + player->map->draw_offset.y -
-            (player->bbox.y + player->bbox.h) * scale;
-    if (player->status == ENTITY_STATUS_JUMP) {
-        int index = 0;
-        if (player->velocity.y < -100) {
-            index = 0;
-        } else if (player->velocity.y < -50) {
-            index = 1;
+    Camera* camera = &player->map->camera;
+    int scale = camera->scale;
+    int x = pos.x * scale + camera->offset.x - bbox->x * scale;
+    int y = pos.y * scale + camera->offset.y - (bbox->y + bbox->h) * scale;
+    SDL_Color white = {255, 255, 255, 255};
+    if (*status == ENTITY_STATUS_JUMP) {
+        int frame = 0;
+        if (velocity->y < -100) {
+            frame = 0;
+        } else if (velocity->y < -50) {
+            frame = 1;
         } else {
-            index = 2;
+            frame = 2;
         }
         SDL_Rect* texture_rect = data->with_sword
                                    ? jump_with_sword_texture_rect
                                    : jump_without_sword_texture_rect;
-        SDL_RenderCopyEx(
-            game_app.renderer, captain_texture, &texture_rect[index],
-            &(SDL_Rect){x, y, 56 * scale, 40 * scale}, 0, NULL,
+        SubmitTextureEx(
+            captain_texture, &texture_rect[frame],
+            &(SDL_FRect){x, y, 56 * scale, 40 * scale}, white, 0, NULL,
             data->facing_right ? SDL_FLIP_NONE : SDL_FLIP_HORIZONTAL
         );
-    } else if (player->status == ENTITY_STATUS_FALL) {
+    } else if (*status == ENTITY_STATUS_FALL) {
         SDL_Rect* texture_rect = data->with_sword
                                    ? &fall_with_sword_texture_rect
                                    : &fall_without_sword_texture_rect;
-        SDL_RenderCopyEx(
-            game_app.renderer, captain_texture, texture_rect,
-            &(SDL_Rect){x, y, 56 * scale, 40 * scale}, 0, NULL,
+        SubmitTextureEx(
+            captain_texture, texture_rect,
+            &(SDL_FRect){x, y, 56 * scale, 40 * scale}, white, 0, NULL,
             data->facing_right ? SDL_FLIP_NONE : SDL_FLIP_HORIZONTAL
         );
-    } else if (player->status == ENTITY_STATUS_GROUND) {
-        int index = 0;
+    } else if (*status == ENTITY_STATUS_GROUND) {
+        int frame = 0;
         if (data->ground_cooldown_time < 0.1) {
-            index = 1;
+            frame = 1;
         }
         SDL_Rect* texture_rect = data->with_sword
                                    ? ground_with_sword_texture_rect
                                    : ground_without_sword_texture_rect;
-        SDL_RenderCopyEx(
-            game_app.renderer, captain_texture, &texture_rect[index],
-            &(SDL_Rect){x, y, 56 * scale, 40 * scale}, 0, NULL,
+        SubmitTextureEx(
+            captain_texture, &texture_rect[frame],
+            &(SDL_FRect){x, y, 56 * scale, 40 * scale}, white, 0, NULL,
             data->facing_right ? SDL_FLIP_NONE : SDL_FLIP_HORIZONTAL
         );
-    } else {
-        Animation* anim = NULL;
-        switch (player->status) {
-        case ENTITY_STATUS_IDLE:
-            anim = data->with_sword ? idle_with_sword_animation
-                                    : idle_without_sword_animation;
-            break;
-        case ENTITY_STATUS_RUN:
-            anim = data->with_sword ? run_with_sword_animation
-                                    : run_without_sword_animation;
-            break;
-        case ENTITY_STATUS_ATTACK:
-            anim = attack_with_seord_animation_list[data->attack_variant];
-        default:
-            break;
-        }
+    } else if (store->animation[index].animation) {
         DrawAnimationEx(
-            anim, x, y, scale, 0, NULL,
+            &store->animation[index], x, y, scale, 0, NULL,
             data->facing_right ? SDL_FLIP_NONE : SDL_FLIP_HORIZONTAL
         );
     }
 #if !defined(NDEBUG)
     int r = 0, g = 0, b = 0;
-    switch (player->status) {
+    switch (*status) {
     case ENTITY_STATUS_IDLE:
         r = 255;
         break;
@@ -443,30 +375,27 @@ void DrawPlayerEntity(Entity* player) {
     default:
         break;
     }
-    SDL_SetRenderDrawColor(game_app.renderer, r, g, b, 255);
-    SDL_FRect bbox = {
-        player->pos.x * scale + player->map->draw_offset.x,
-        player->pos.y * scale + player->map->draw_offset.y -
-            player->bbox.h * scale,
-        player->bbox.w * scale, player->bbox.h * scale
+    PushRenderLayer(RENDER_LAYER_DEBUG, RENDER_ORDER_SUBMITTED);
+    SDL_FRect bbox_rect = {
+        pos.x * scale + camera->offset.x,
+        pos.y * scale + camera->offset.y - bbox->h * scale, bbox->w * scale,
+        bbox->h * scale
     };
-    SDL_RenderDrawRectF(game_app.renderer, &bbox);
+    SubmitDrawRect(&bbox_rect, (SDL_Color){r, g, b, 255});
     if (player->is_attacking) {
-        SDL_SetRenderDrawColor(game_app.renderer, 255, 128, 0, 128);
         SDL_FRect hitbox = {
-            player->pos.x * scale + player->map->draw_offset.x +
-                player->hitbox.x * scale,
-            player->pos.y * scale + player->map->draw_offset.y -
-                player->hitbox.y * scale,
+            pos.x * scale + camera->offset.x + player->hitbox.x * scale,
+            pos.y * scale + camera->offset.y - player->hitbox.y * scale,
             player->hitbox.w * scale, player->hitbox.h * scale
         };
-        SDL_RenderFillRectF(game_app.renderer, &hitbox);
+        SubmitFillRect(&hitbox, (SDL_Color){255, 128, 0, 128});
     }
+    PopRenderLayer();
 #endif
 }
 
-void FreePlayerEntity(Entity* player) {
-    assert(player->type == ENTITY_TYPE_PLAYER);
+void FreePlayerEntity(EntityStore* store, int index) {
+    assert(store->type[index] == ENTITY_TYPE_PLAYER);
+    Entity* player = &store->data[index];
     free(player->userdata);
-    free(player);
 }
@@ -28,12 +28,17 @@
 #include "base.h"
 #include <SDL.h>
 
+#define PLAYER_RUN_VELOCITY 120
+#define PLAYER_JUMP_VELOCITY (-150)
+
 extern GameApp game_app;
 
 typedef struct PlayerUserData {
+    // the animation playback calls back with this struct, as its `userdata`
+    EntityHandle handle;
+    Map* map;
     int facing_right;
     int with_sword;
-    int running_direction;
     int attack_variant;
     float last_attack_time;
     float ground_cooldown_time;
@@ -41,11 +46,10 @@ typedef struct PlayerUserData {
 
 void InitPlayerTexture();
 void FreePlayerTexture();
-Entity* CreatePlayerEntity(Map* map, float x, float y);
-void OnPlayerAttackAnimationEnd(void* userdata, Animation* anim);
-void TickPlayer(Entity* player, float dt);
-void HandlePlayerEvent(Entity* player, SDL_Event* event);
-void DrawPlayerEntity(Entity* player);
-void FreePlayerEntity(Entity* player);
+EntityHandle CreatePlayerEntity(Map* map, float x, float y);
+void OnPlayerAnimationEnd(void* userdata, AnimationPlayback* playback);
+void TickPlayer(EntityStore* store, int index, float dt);
+void DrawPlayerEntity(EntityStore* store, int index);
+void FreePlayerEntity(EntityStore* store, int index);
 
 #endif
@@ -0,0 +1,49 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/*
+  Implementations of the single-header libraries in `external/`. They are
+  kept out of `main.c`, so that the tests can link against them too.
+*/
+
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+  Maps are loaded with their arena as `mem_ctx`, so the parsed map is freed
+  together with the arena and `cute_tiled_free_map` is not needed. Memory is
+  never given back to an arena: when cute_tiled grows an array (its string
+  pool does while a map is parsed), the old array stays in the arena unused
+  until the map is freed.
+
+  Without a `mem_ctx`, cute_tiled falls back to `malloc` and `free`.
+*/
+#define CUTE_TILED_ALLOC(size, ctx)                                            \
+    ((ctx) ? ArenaAlloc((Arena*)(ctx), (size)) : malloc(size))
+#define CUTE_TILED_FREE(mem, ctx) ((ctx) ? (void)(mem) : free(mem))
+#define STRPOOL_EMBEDDED_MALLOC(ctx, size) CUTE_TILED_ALLOC(size, ctx)
+#define STRPOOL_EMBEDDED_FREE(ctx, ptr) CUTE_TILED_FREE(ptr, ctx)
+#define CUTE_TILED_IMPLEMENTATION
+#include "cute_tiled.h"
+#define FRAMETIMER_IMPLEMENTATION
+#include "frametimer.h"
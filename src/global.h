@@ -59,6 +59,8 @@ typedef struct GameApp {
     int should_quit;
     float interface_size;
     frametimer_t* timer;
+    // seconds since the game loop started, advanced once per frame
+    double clock;
     GameStatus status;
     struct {
         SDL_GameController* device;
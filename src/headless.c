@@ -0,0 +1,209 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "headless.h"
+#include "entities/base.h"
+#include "entities/player.h"
+#include "global.h"
+#include "image/image.h"
+#include "input.h"
+#include "jobs.h"
+#include "map.h"
+#include "particles.h"
+#include "scenes/world.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HEADLESS_DEFAULT_TICKS 10000
+
+extern GameApp game_app;
+
+int IsHeadlessMode(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+double GetElapsedSeconds(Uint64 start) {
+    return (double)(SDL_GetPerformanceCounter() - start) /
+           SDL_GetPerformanceFrequency();
+}
+
+void PrintPhaseTime(char* name, Uint64 counter, int ticks) {
+    double seconds = (double)counter / SDL_GetPerformanceFrequency();
+    printf(
+        "%-9s%10.3f ms %10.3f us/tick\n", name, seconds * 1000.0,
+        seconds * 1e6 / ticks
+    );
+}
+
+/*
+  Spread `count` extra entities over the walkable spans of the map.
+*/
+void SpawnBenchmarkEntities(Map* map, int count) {
+    NavGraph* graph = map->nav;
+    if (graph->span_count == 0) {
+        return;
+    }
+    for (int i = 0; i < count; ++i) {
+        NavSpan* span = &graph->spans[i % graph->span_count];
+        int width = span->x1 - span->x0 + 1;
+        int x = span->x0 + (i / graph->span_count) % width;
+        CreatePlayerEntity(
+            map, (float)x * map->tilemap->tilewidth,
+            (float)(span->y + 1) * map->tilemap->tileheight
+        );
+    }
+}
+
+/*
+  Emit sparks over the walkable spans of the map until about `count`
+  particles are alive, so that the particle system is measured under a
+  steady load.
+*/
+void EmitBenchmarkParticles(Map* map, int count, int tick) {
+    NavGraph* graph = map->nav;
+    if (graph->span_count == 0) {
+        return;
+    }
+    for (int i = tick; map->particles->count < count; ++i) {
+        NavSpan* span = &graph->spans[i % graph->span_count];
+        EmitParticles(
+            map->particles, PARTICLE_EFFECT_SPARKS,
+            (float)span->x0 * map->tilemap->tilewidth,
+            (float)span->y * map->tilemap->tileheight
+        );
+    }
+}
+
+/*
+  Load a map and step the world simulation without a window, renderer or audio
+  device, then print the throughput and the time spent in every phase.
+
+  Options:
+    --map <name>      map in the resource pack, `maps/start.tmx` by default
+    --ticks <n>       number of simulation steps, 10000 by default
+    --seconds <s>     run for `s` seconds instead of a fixed number of steps
+    --entities <n>    extra entities spawned on walkable surfaces
+    --particles <n>   particles kept alive on walkable surfaces
+
+  With `--replay <file>` the recorded input drives the player, and the run
+  lasts as long as the recording unless `--ticks` or `--seconds` is given.
+*/
+int RunHeadless(int argc, char* argv[]) {
+    char* map_name = "maps/start.tmx";
+    int max_ticks = HEADLESS_DEFAULT_TICKS;
+    double max_seconds = 0;
+    int extra_entities = 0;
+    int particles = 0;
+    if (input_system.mode == INPUT_MODE_REPLAY) {
+        max_ticks = INT_MAX;
+    }
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--map") == 0 && i + 1 < argc) {
+            map_name = argv[++i];
+        } else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+            max_ticks = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            max_seconds = atof(argv[++i]);
+            max_ticks = 0;
+        } else if (strcmp(argv[i], "--entities") == 0 && i + 1 < argc) {
+            extra_entities = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--particles") == 0 && i + 1 < argc) {
+            particles = atoi(argv[++i]);
+        }
+    }
+    particles = SDL_min(particles, MAX_PARTICLES);
+    // without a window, the camera follows the focus in a view of the usual
+    // size
+    SetFixedRenderView(1);
+    InitEntitySystem();
+    InitMapSystem();
+    InitParticleSystem();
+    Uint64 start = SDL_GetPerformanceCounter();
+    Map* map = LoadMap(map_name);
+    double load_time = GetElapsedSeconds(start);
+    if (!map) {
+        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "cannot load map %s", map_name);
+        QuitParticleSystem();
+        QuitMapSystem();
+        QuitEntitySystem();
+        return EXIT_FAILURE;
+    }
+    SpawnBenchmarkEntities(map, extra_entities);
+    EntityStore* store = map->entities;
+    WorldProfile profile = {0};
+    Uint64 view = 0;
+    int ticks = 0;
+    start = SDL_GetPerformanceCounter();
+    while (max_ticks > 0 ? ticks < max_ticks
+                         : GetElapsedSeconds(start) < max_seconds) {
+        if (!UpdateInput()) {
+            break;
+        }
+        EmitBenchmarkParticles(map, particles, ticks);
+        // the same update as the world scene, without drawing
+        StepWorld(map, &profile);
+        Uint64 t0 = SDL_GetPerformanceCounter();
+        UpdateWorldView(map, 1.0f);
+        view += SDL_GetPerformanceCounter() - t0;
+        ++ticks;
+    }
+    double total = GetElapsedSeconds(start);
+    printf("map      %s (loaded in %.3f ms)\n", map_name, load_time * 1000.0);
+    int awake = 0, resting = 0;
+    ForEachEntity(i, store) {
+        awake += store->activity[i] == ENTITY_ACTIVITY_AWAKE;
+        resting += store->activity[i] == ENTITY_ACTIVITY_RESTING;
+    }
+    printf(
+        "entities %d (%d awake, %d resting, %d distant at the end)\n",
+        store->count, awake, resting, store->count - awake - resting
+    );
+    printf("workers  %d job threads\n", GetJobWorkerCount());
+    printf(
+        "effects  %d particles alive at the end\n", map->particles->count
+    );
+    printf(
+        "ticks    %d in %.3f s, %.1f ticks/s (%.1fx real time at %d Hz)\n",
+        ticks, total, ticks / total, ticks * SIMULATION_STEP / total,
+        TH_SIMULATION_RATE
+    );
+    if (ticks > 0) {
+        PrintPhaseTime("physics", profile.physics, ticks);
+        PrintPhaseTime("logic", profile.logic, ticks);
+        PrintPhaseTime("animation", profile.animation, ticks);
+        PrintPhaseTime("cleanup", profile.cleanup, ticks);
+        PrintPhaseTime("particles", profile.particles, ticks);
+        PrintPhaseTime("view", view, ticks);
+    }
+    FreeMap(map);
+    QuitParticleSystem();
+    QuitMapSystem();
+    QuitEntitySystem();
+    return EXIT_SUCCESS;
+}
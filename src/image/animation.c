@@ -21,7 +21,6 @@
 */
 
 #include "../global.h"
-#include "frametimer.h"
 #include "image.h"
 
 extern GameApp game_app;
@@ -31,9 +30,7 @@ Animation* CreateAnimation(
 ) {
     Animation* animation = (Animation*)calloc(1, sizeof(Animation));
     animation->count = count;
-    animation->paused = 0;
-    animation->now_clip = 0;
-    animation->dt = 0;
+    animation->duration = duration * count;
     animation->texture = texture;
     animation->clip = (AnimationClip*)calloc(count, sizeof(AnimationClip));
     for (int i = 0; i < count; ++i) {
@@ -48,37 +45,114 @@ void FreeAnimation(Animation* animation) {
     free(animation);
 }
 
-void DrawAnimationEx(
-    Animation* animation, float x, float y, float scale, double angle,
-    SDL_FPoint* center, SDL_RendererFlip flip
+void InitAnimationPlayback(
+    AnimationPlayback* playback, const Animation* animation
+) {
+    *playback = (AnimationPlayback){.animation = animation};
+}
+
+/*
+  Play another animation from its first clip. Nothing happens if `animation`
+  is already playing, the callback is kept in both cases.
+*/
+void SetPlaybackAnimation(
+    AnimationPlayback* playback, const Animation* animation
+) {
+    if (playback->animation != animation) {
+        playback->animation = animation;
+        playback->now_clip = 0;
+        playback->dt = 0;
+    }
+}
+
+void AdvanceAnimation(AnimationPlayback* playback, float dt) {
+    const Animation* animation = playback->animation;
+    if (playback->paused) {
+        playback->dt = 0;
+        return;
+    }
+    playback->dt += dt;
+    // a long step may pass several clips
+    while (playback->dt > animation->clip[playback->now_clip].duration) {
+        playback->dt -= animation->clip[playback->now_clip].duration;
+        if (playback->now_clip + 1 > animation->count - 1) {
+            playback->now_clip = 0;
+            if (playback->on_animation_end) {
+                playback->on_animation_end(playback->userdata, playback);
+            }
+            if (playback->animation != animation) {
+                // the callback switched to another animation
+                break;
+            }
+        } else {
+            ++playback->now_clip;
+        }
+    }
+}
+
+/*
+  Advance every playback which has an animation by `dt` seconds. This is the
+  only place where animations move on.
+*/
+void UpdateAnimations(AnimationPlayback* playbacks, int count, float dt) {
+    for (int i = 0; i < count; ++i) {
+        if (playbacks[i].animation) {
+            AdvanceAnimation(&playbacks[i], dt);
+        }
+    }
+}
+
+/*
+  Return the clip a looping animation shows at `time`, without any state.
+*/
+int GetAnimationClipAt(const Animation* animation, double time) {
+    float t = SDL_fmod(time, animation->duration);
+    for (int i = 0; i < animation->count - 1; ++i) {
+        t -= animation->clip[i].duration;
+        if (t < 0) {
+            return i;
+        }
+    }
+    return animation->count - 1;
+}
+
+void DrawAnimationClipEx(
+    const Animation* animation, int clip, float x, float y, float scale,
+    double angle, SDL_FPoint* center, SDL_RendererFlip flip
 ) {
     SDL_FRect dstrect = {
-        x, y, animation->clip[animation->now_clip].area.w * scale,
-        animation->clip[animation->now_clip].area.h * scale
+        x, y, animation->clip[clip].area.w * scale,
+        animation->clip[clip].area.h * scale
     };
-    SDL_RenderCopyExF(
-        game_app.renderer, animation->texture,
-        &animation->clip[animation->now_clip].area, &dstrect, angle, center,
+    SubmitTextureEx(
+        animation->texture, &animation->clip[clip].area, &dstrect,
+        (SDL_Color){255, 255, 255, 255}, angle, center, flip
+    );
+}
+
+void DrawAnimationEx(
+    AnimationPlayback* playback, float x, float y, float scale, double angle,
+    SDL_FPoint* center, SDL_RendererFlip flip
+) {
+    DrawAnimationClipEx(
+        playback->animation, playback->now_clip, x, y, scale, angle, center,
         flip
     );
-    if (animation->paused) {
-        animation->dt = 0;
-    } else {
-        animation->dt += frametimer_delta_time(game_app.timer);
-        if (animation->dt > animation->clip[animation->now_clip].duration) {
-            if (animation->now_clip + 1 > animation->count - 1) {
-                animation->now_clip = 0;
-                if (animation->on_animation_end) {
-                    animation->on_animation_end(animation->userdata, animation);
-                }
-            } else {
-                ++animation->now_clip;
-            }
-            animation->dt = 0;
-        }
-    }
 }
 
-void DrawAnimation(Animation* animation, float x, float y, float scale) {
-    DrawAnimationEx(animation, x, y, scale, 0.0, NULL, SDL_FLIP_NONE);
+void DrawAnimation(AnimationPlayback* playback, float x, float y, float scale) {
+    DrawAnimationEx(playback, x, y, scale, 0.0, NULL, SDL_FLIP_NONE);
+}
+
+/*
+  Draw a looping animation at the global clock, so that it needs neither a
+  playback nor an update.
+*/
+void DrawLoopedAnimation(
+    const Animation* animation, float x, float y, float scale
+) {
+    DrawAnimationClipEx(
+        animation, GetAnimationClipAt(animation, game_app.clock), x, y, scale,
+        0.0, NULL, SDL_FLIP_NONE
+    );
 }
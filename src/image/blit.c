@@ -0,0 +1,151 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/*
+  Alpha blending of 32-bit surfaces without touching SDL's blit maps, so it can
+  be called from worker threads which share the same source surface.
+
+  Uses the same formula as `SDL_BLENDMODE_BLEND`:
+    dstRGB = srcRGB * srcA + dstRGB * (1 - srcA)
+    dstA = srcA + dstA * (1 - srcA)
+*/
+
+#include "image.h"
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define TH_BLIT_SSE2
+#endif
+
+#define MAX_BLIT_ROW 1024
+
+static inline Uint32 BlendPixel(Uint32 dst, Uint32 src) {
+    Uint32 sa = src >> 24;
+    Uint32 inv = 255 - sa;
+    Uint32 out = 0;
+    for (int shift = 0; shift < 24; shift += 8) {
+        Uint32 x = ((src >> shift) & 0xff) * sa + ((dst >> shift) & 0xff) * inv;
+        out |= ((x + 128 + ((x + 128) >> 8)) >> 8) << shift;
+    }
+    Uint32 x = sa * 255 + (dst >> 24) * inv;
+    out |= ((x + 128 + ((x + 128) >> 8)) >> 8) << 24;
+    return out;
+}
+
+#if defined(TH_BLIT_SSE2)
+/*
+  Blend two pixels held in the low 64 bits of `s` and `d`, widened to 16 bits
+  per channel.
+*/
+static inline __m128i BlendTwoPixelsSSE2(__m128i s, __m128i d) {
+    const __m128i alpha_lane = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+    const __m128i color_mask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    const __m128i c255 = _mm_set1_epi16(255);
+    const __m128i c128 = _mm_set1_epi16(128);
+    __m128i a = _mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3));
+    a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+    // multiply color channels by alpha, and alpha channel by 255
+    __m128i sa = _mm_or_si128(_mm_and_si128(a, color_mask), alpha_lane);
+    __m128i x = _mm_add_epi16(
+        _mm_mullo_epi16(s, sa), _mm_mullo_epi16(d, _mm_sub_epi16(c255, a))
+    );
+    x = _mm_add_epi16(x, c128);
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+#endif
+
+static void BlendRow(Uint32* dst, const Uint32* src, int count) {
+    int i = 0;
+#if defined(TH_BLIT_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha_mask = _mm_set1_epi32((int)0xff000000);
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i sa = _mm_and_si128(s, alpha_mask);
+        int transparent = _mm_movemask_epi8(_mm_cmpeq_epi32(sa, zero));
+        if (transparent == 0xffff) {
+            continue;
+        }
+        int opaque = _mm_movemask_epi8(_mm_cmpeq_epi32(sa, alpha_mask));
+        if (opaque == 0xffff) {
+            _mm_storeu_si128((__m128i*)(dst + i), s);
+            continue;
+        }
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i lo = BlendTwoPixelsSSE2(
+            _mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero)
+        );
+        __m128i hi = BlendTwoPixelsSSE2(
+            _mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero)
+        );
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < count; ++i) {
+        Uint32 sa = src[i] >> 24;
+        if (sa == 0xff) {
+            dst[i] = src[i];
+        } else if (sa != 0) {
+            dst[i] = BlendPixel(dst[i], src[i]);
+        }
+    }
+}
+
+/*
+  Blend `srcrect` of `src` onto `dst` at (x, y). Both surfaces must be 32-bit
+  with alpha in the highest byte (`SDL_PIXELFORMAT_ARGB8888`).
+
+  Thread-safe as long as no two threads write the same pixels of `dst`.
+*/
+void BlendSurfaceRegion(
+    SDL_Surface* src, SDL_Rect* srcrect, SDL_Surface* dst, int x, int y,
+    SDL_RendererFlip flip
+) {
+    SDL_Rect dstrect = {x, y, srcrect->w, srcrect->h};
+    SDL_Rect clipped;
+    if (!SDL_IntersectRect(&dstrect, &(SDL_Rect){0, 0, dst->w, dst->h},
+                           &clipped)) {
+        return;
+    }
+    Uint32 row[MAX_BLIT_ROW];
+    int count = SDL_min(clipped.w, MAX_BLIT_ROW);
+    for (int dy = clipped.y; dy < clipped.y + clipped.h; ++dy) {
+        int sy = dy - y;
+        if (flip & SDL_FLIP_VERTICAL) {
+            sy = srcrect->h - 1 - sy;
+        }
+        const Uint32* src_row =
+            (const Uint32*)((Uint8*)src->pixels +
+                            (srcrect->y + sy) * src->pitch) +
+            srcrect->x;
+        int sx = clipped.x - x;
+        if (flip & SDL_FLIP_HORIZONTAL) {
+            for (int i = 0; i < count; ++i) {
+                row[i] = src_row[srcrect->w - 1 - (sx + i)];
+            }
+        } else {
+            SDL_memcpy(row, src_row + sx, count * sizeof(Uint32));
+        }
+        Uint32* dst_row =
+            (Uint32*)((Uint8*)dst->pixels + dy * dst->pitch) + clipped.x;
+        BlendRow(dst_row, row, count);
+    }
+}
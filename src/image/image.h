@@ -34,16 +34,34 @@ typedef struct AnimationClip {
     SDL_Rect area;
 } AnimationClip;
 
+/*
+  Clips of an animation. It is never changed after creation, so any number of
+  `AnimationPlayback` can share it.
+*/
 typedef struct Animation {
     int count;
+    // sum of the durations of all clips
+    float duration;
+    SDL_Texture* texture;
+    AnimationClip* clip;
+} Animation;
+
+/*
+  Where one user of an animation is in it. `on_animation_end` is called with
+  `userdata` every time the last clip finishes.
+
+  Drawing never advances a playback, its owner does with `UpdateAnimations`.
+  Looping animations which nothing waits for need no playback at all, see
+  `DrawLoopedAnimation`.
+*/
+typedef struct AnimationPlayback {
+    const Animation* animation;
     int paused;
     int now_clip;
     float dt;
-    SDL_Texture* texture;
-    AnimationClip* clip;
     void* userdata;
-    void (*on_animation_end)(void*, struct Animation*);
-} Animation;
+    void (*on_animation_end)(void*, struct AnimationPlayback*);
+} AnimationPlayback;
 
 typedef enum SpriteType {
     SPRITE_TYPE_TEXTURE,
@@ -53,7 +71,7 @@ typedef enum SpriteType {
 typedef struct Sprite {
     SpriteType type;
     union {
-        Animation* animation;
+        AnimationPlayback animation;
         SDL_Texture* texture;
     } image;
     SDL_FRect area;
@@ -63,15 +81,134 @@ typedef struct Sprite {
     SDL_RendererFlip flip;
 } Sprite;
 
+// nested calls of `PushRenderLayer`
+#define RENDER_LAYER_STACK_SIZE 8
+// size of the view when it is drawn at a fixed resolution and upscaled, see
+// `SetFixedRenderView`
+#define RENDER_VIEW_WIDTH 384
+#define RENDER_VIEW_HEIGHT 216
+
+/*
+  What is drawn where, from back to front. A later layer always covers an
+  earlier one, no matter when it was submitted.
+*/
+typedef enum RenderLayer {
+    RENDER_LAYER_BACKGROUND,
+    RENDER_LAYER_MAP_BACK,
+    RENDER_LAYER_MAP_MIDDLE,
+    RENDER_LAYER_ENTITIES,
+    RENDER_LAYER_PARTICLES,
+    RENDER_LAYER_MAP_FRONT,
+    RENDER_LAYER_DEBUG,
+    RENDER_LAYER_UI,
+    RENDER_LAYER_COUNT
+} RenderLayer;
+
+typedef enum RenderOrder {
+    // drawn in the order they were submitted, like immediate drawing
+    RENDER_ORDER_SUBMITTED,
+    // grouped by texture, only commands of the same texture keep their
+    // order, for things of different textures which never overlap
+    RENDER_ORDER_BY_TEXTURE
+} RenderOrder;
+
+typedef enum RenderCommandType {
+    RENDER_COMMAND_QUADS,
+    RENDER_COMMAND_FILL_RECT,
+    RENDER_COMMAND_DRAW_RECT
+} RenderCommandType;
+
+typedef struct RenderCommand {
+    RenderCommandType type;
+    SDL_BlendMode blend;
+    // `count` textured quads, their vertices start at `first_vertex`
+    SDL_Texture* texture;
+    int first_vertex;
+    int count;
+    // an untextured rectangle
+    SDL_FRect rect;
+    SDL_Color color;
+} RenderCommand;
+
+typedef struct RenderSortItem {
+    Uint64 key;
+    int command;
+} RenderSortItem;
+
+/*
+  Drawing commands of one frame. Every command has a 64-bit key made of its
+  layer, its depth in the layer, its texture and its blend mode, and the
+  queue is sorted by the keys before it is drawn. Runs of quads which share a
+  texture and a blend mode become one `SDL_RenderGeometry`, no matter which
+  part of the game submitted them.
+
+  The queue only holds plain data, so the commands of a frame could be built
+  on another thread.
+*/
+typedef struct RenderQueue {
+    struct {
+        RenderLayer layer;
+        RenderOrder order;
+    } stack[RENDER_LAYER_STACK_SIZE];
+    int stack_size;
+    // next depth of every layer in `RENDER_ORDER_SUBMITTED`
+    Uint32 next_depth[RENDER_LAYER_COUNT];
+    int count;
+    int capacity;
+    RenderCommand* commands;
+    RenderSortItem* items;
+    RenderSortItem* sorted;
+    int vertex_count;
+    int vertex_capacity;
+    SDL_Vertex* vertices;
+    // a run of quads is copied here if it is made of several commands
+    int run_capacity;
+    SDL_Vertex* run_vertices;
+    // six indices per quad, the same for every run
+    int index_quads;
+    int* indices;
+    // textures which are only used by this frame
+    struct {
+        int count;
+        int capacity;
+        SDL_Texture** data;
+    } garbage;
+    // the layers below `RENDER_LAYER_UI` are drawn to `view_target` and
+    // upscaled to the window in one copy
+    int fixed_view;
+    SDL_Texture* view_target;
+    // the size of the window, updated by `UpdateRenderWindowSize`
+    int window_w;
+    int window_h;
+} RenderQueue;
+
+extern RenderQueue render_queue;
+
 Animation* CreateAnimation(
     SDL_Texture* texture, float duration, SDL_Rect* rect, int count
 );
 void FreeAnimation(Animation* animation);
+void InitAnimationPlayback(
+    AnimationPlayback* playback, const Animation* animation
+);
+void SetPlaybackAnimation(
+    AnimationPlayback* playback, const Animation* animation
+);
+void AdvanceAnimation(AnimationPlayback* playback, float dt);
+void UpdateAnimations(AnimationPlayback* playbacks, int count, float dt);
+int GetAnimationClipAt(const Animation* animation, double time);
+void DrawAnimationClipEx(
+    const Animation* animation, int clip, float x, float y, float scale,
+    double angle, SDL_FPoint* center, SDL_RendererFlip flip
+);
 void DrawAnimationEx(
-    Animation* animation, float x, float y, float scale, double angle,
+    AnimationPlayback* playback, float x, float y, float scale, double angle,
     SDL_FPoint* center, SDL_RendererFlip flip
 );
-void DrawAnimation(Animation* animation, float x, float y, float scale);
+void DrawAnimation(AnimationPlayback* playback, float x, float y, float scale);
+void DrawLoopedAnimation(
+    const Animation* animation, float x, float y, float scale
+);
 
 Sprite* CreateTextureSprite(SDL_Texture* texture);
 Sprite* CreateAnimationSprite(Animation* animation);
@@ -80,4 +217,31 @@ void SetSpritePosition(Sprite* sprite, float x, float y);
 void SetSpriteSize(Sprite* sprite, float w, float h);
 void DrawSprite(Sprite* sprite);
 
+void PushRenderLayer(RenderLayer layer, RenderOrder order);
+void PopRenderLayer();
+void SubmitTextureEx(
+    SDL_Texture* texture, const SDL_Rect* src, const SDL_FRect* dst,
+    SDL_Color color, double angle, const SDL_FPoint* center,
+    SDL_RendererFlip flip
+);
+void SubmitTexture(
+    SDL_Texture* texture, const SDL_Rect* src, const SDL_FRect* dst,
+    SDL_Color color
+);
+SDL_Vertex* SubmitQuads(SDL_Texture* texture, int count);
+void TrimSubmittedQuads(int count);
+void SubmitFillRect(const SDL_FRect* rect, SDL_Color color);
+void SubmitDrawRect(const SDL_FRect* rect, SDL_Color color);
+void DestroyTextureAfterFlush(SDL_Texture* texture);
+void UpdateRenderWindowSize();
+void SetFixedRenderView(int enabled);
+void GetRenderViewSize(int* w, int* h);
+void FlushRenderQueue();
+void FreeRenderQueue();
+
+void BlendSurfaceRegion(
+    SDL_Surface* src, SDL_Rect* srcrect, SDL_Surface* dst, int x, int y,
+    SDL_RendererFlip flip
+);
+
 #endif
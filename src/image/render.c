@@ -0,0 +1,515 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "../global.h"
+#include "image.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// fields of a render key, from the most significant bits: 8 bits of layer,
+// 24 of depth, 24 of texture and 8 of blend mode
+#define RENDER_KEY_LAYER_SHIFT 56
+#define RENDER_KEY_DEPTH_SHIFT 32
+#define RENDER_KEY_TEXTURE_SHIFT 8
+#define RENDER_KEY_FIELD_MASK 0xffffff
+
+extern GameApp game_app;
+
+RenderQueue render_queue = {};
+
+/*
+  Submit the following commands to `layer` until the matching
+  `PopRenderLayer`. Outside of any layer commands go to the UI layer in the
+  order they are submitted.
+*/
+void PushRenderLayer(RenderLayer layer, RenderOrder order) {
+    assert(render_queue.stack_size < RENDER_LAYER_STACK_SIZE);
+    render_queue.stack[render_queue.stack_size].layer = layer;
+    render_queue.stack[render_queue.stack_size].order = order;
+    ++render_queue.stack_size;
+}
+
+void PopRenderLayer() {
+    assert(render_queue.stack_size > 0);
+    --render_queue.stack_size;
+}
+
+Uint64 GetRenderKey(SDL_Texture* texture, SDL_BlendMode blend) {
+    RenderLayer layer = RENDER_LAYER_UI;
+    RenderOrder order = RENDER_ORDER_SUBMITTED;
+    if (render_queue.stack_size > 0) {
+        layer = render_queue.stack[render_queue.stack_size - 1].layer;
+        order = render_queue.stack[render_queue.stack_size - 1].order;
+    }
+    Uint32 depth = 0;
+    if (order == RENDER_ORDER_SUBMITTED) {
+        depth = render_queue.next_depth[layer]++ & RENDER_KEY_FIELD_MASK;
+    }
+    // only equal textures have to end up next to each other, so a few bits
+    // of the address are enough
+    Uint32 id = ((uintptr_t)texture >> 4) & RENDER_KEY_FIELD_MASK;
+    return (Uint64)layer << RENDER_KEY_LAYER_SHIFT |
+           (Uint64)depth << RENDER_KEY_DEPTH_SHIFT |
+           (Uint64)id << RENDER_KEY_TEXTURE_SHIFT | (blend & 0xff);
+}
+
+RenderCommand* AddRenderCommand(
+    RenderCommandType type, SDL_Texture* texture, SDL_BlendMode blend
+) {
+    if (render_queue.count == render_queue.capacity) {
+        render_queue.capacity =
+            render_queue.capacity ? 2 * render_queue.capacity : 256;
+        render_queue.commands = realloc(
+            render_queue.commands,
+            render_queue.capacity * sizeof(RenderCommand)
+        );
+        render_queue.items = realloc(
+            render_queue.items, render_queue.capacity * sizeof(RenderSortItem)
+        );
+        render_queue.sorted = realloc(
+            render_queue.sorted, render_queue.capacity * sizeof(RenderSortItem)
+        );
+    }
+    int index = render_queue.count++;
+    render_queue.items[index].key = GetRenderKey(texture, blend);
+    render_queue.items[index].command = index;
+    RenderCommand* command = &render_queue.commands[index];
+    command->type = type;
+    command->blend = blend;
+    command->texture = texture;
+    return command;
+}
+
+/*
+  Submit `count` quads of `texture` and return their vertices, four per quad
+  in clockwise order, which the caller fills in before submitting anything
+  else.
+*/
+SDL_Vertex* SubmitQuads(SDL_Texture* texture, int count) {
+    if (render_queue.vertex_count + 4 * count > render_queue.vertex_capacity) {
+        while (render_queue.vertex_count + 4 * count >
+               render_queue.vertex_capacity) {
+            render_queue.vertex_capacity = render_queue.vertex_capacity
+                                             ? 2 * render_queue.vertex_capacity
+                                             : 1024;
+        }
+        render_queue.vertices = realloc(
+            render_queue.vertices,
+            render_queue.vertex_capacity * sizeof(SDL_Vertex)
+        );
+    }
+    SDL_BlendMode blend = SDL_BLENDMODE_BLEND;
+    SDL_GetTextureBlendMode(texture, &blend);
+    RenderCommand* command =
+        AddRenderCommand(RENDER_COMMAND_QUADS, texture, blend);
+    command->first_vertex = render_queue.vertex_count;
+    command->count = count;
+    render_queue.vertex_count += 4 * count;
+    return &render_queue.vertices[command->first_vertex];
+}
+
+/*
+  Keep only the first `count` quads of the last `SubmitQuads`, for callers
+  which find out how many they need while filling them in.
+*/
+void TrimSubmittedQuads(int count) {
+    assert(render_queue.count > 0);
+    RenderCommand* command = &render_queue.commands[render_queue.count - 1];
+    assert(command->type == RENDER_COMMAND_QUADS && count <= command->count);
+    render_queue.vertex_count -= 4 * (command->count - count);
+    command->count = count;
+    if (count == 0) {
+        --render_queue.count;
+    }
+}
+
+/*
+  Submit a part of `texture` like `SDL_RenderCopyExF` draws it, tinted with
+  `color`. `src` and `center` may be `NULL`.
+*/
+void SubmitTextureEx(
+    SDL_Texture* texture, const SDL_Rect* src, const SDL_FRect* dst,
+    SDL_Color color, double angle, const SDL_FPoint* center,
+    SDL_RendererFlip flip
+) {
+    if (!texture) {
+        return;
+    }
+    int texture_w, texture_h;
+    SDL_QueryTexture(texture, NULL, NULL, &texture_w, &texture_h);
+    SDL_Rect area = src ? *src : (SDL_Rect){0, 0, texture_w, texture_h};
+    float u0 = (float)area.x / texture_w;
+    float v0 = (float)area.y / texture_h;
+    float u1 = (float)(area.x + area.w) / texture_w;
+    float v1 = (float)(area.y + area.h) / texture_h;
+    if (flip & SDL_FLIP_HORIZONTAL) {
+        float u = u0;
+        u0 = u1;
+        u1 = u;
+    }
+    if (flip & SDL_FLIP_VERTICAL) {
+        float v = v0;
+        v0 = v1;
+        v1 = v;
+    }
+    SDL_FPoint pivot = center ? *center : (SDL_FPoint){dst->w / 2, dst->h / 2};
+    SDL_FPoint corner[4] = {{0, 0}, {dst->w, 0}, {dst->w, dst->h}, {0, dst->h}};
+    SDL_FPoint uv[4] = {{u0, v0}, {u1, v0}, {u1, v1}, {u0, v1}};
+    float c = 1, s = 0;
+    if (angle != 0) {
+        c = SDL_cos(angle * M_PI / 180.0);
+        s = SDL_sin(angle * M_PI / 180.0);
+    }
+    SDL_Vertex* vertex = SubmitQuads(texture, 1);
+    for (int i = 0; i < 4; ++i) {
+        float dx = corner[i].x - pivot.x;
+        float dy = corner[i].y - pivot.y;
+        vertex[i].position = (SDL_FPoint){
+            dst->x + pivot.x + dx * c - dy * s,
+            dst->y + pivot.y + dx * s + dy * c
+        };
+        vertex[i].color = color;
+        vertex[i].tex_coord = uv[i];
+    }
+}
+
+void SubmitTexture(
+    SDL_Texture* texture, const SDL_Rect* src, const SDL_FRect* dst,
+    SDL_Color color
+) {
+    SubmitTextureEx(texture, src, dst, color, 0, NULL, SDL_FLIP_NONE);
+}
+
+void SubmitFillRect(const SDL_FRect* rect, SDL_Color color) {
+    RenderCommand* command =
+        AddRenderCommand(RENDER_COMMAND_FILL_RECT, NULL, SDL_BLENDMODE_BLEND);
+    command->rect = *rect;
+    command->color = color;
+}
+
+void SubmitDrawRect(const SDL_FRect* rect, SDL_Color color) {
+    RenderCommand* command =
+        AddRenderCommand(RENDER_COMMAND_DRAW_RECT, NULL, SDL_BLENDMODE_BLEND);
+    command->rect = *rect;
+    command->color = color;
+}
+
+/*
+  Destroy `texture` once the queue has been drawn, for textures which are
+  made for one frame only.
+*/
+void DestroyTextureAfterFlush(SDL_Texture* texture) {
+    if (render_queue.garbage.count == render_queue.garbage.capacity) {
+        render_queue.garbage.capacity = render_queue.garbage.capacity
+                                           ? 2 * render_queue.garbage.capacity
+                                           : 16;
+        render_queue.garbage.data = realloc(
+            render_queue.garbage.data,
+            render_queue.garbage.capacity * sizeof(SDL_Texture*)
+        );
+    }
+    render_queue.garbage.data[render_queue.garbage.count++] = texture;
+}
+
+/*
+  Sort the keys with a stable LSD radix sort, one byte at a time, and return
+  the sorted items. A byte which all keys share is skipped, usually the blend
+  mode and most of the depth.
+*/
+RenderSortItem* SortRenderQueue() {
+    RenderSortItem* src = render_queue.items;
+    RenderSortItem* dst = render_queue.sorted;
+    int count = render_queue.count;
+    if (count == 0) {
+        return src;
+    }
+    for (int shift = 0; shift < 64; shift += 8) {
+        int offset[256] = {0};
+        for (int i = 0; i < count; ++i) {
+            ++offset[(src[i].key >> shift) & 0xff];
+        }
+        if (offset[(src[0].key >> shift) & 0xff] == count) {
+            continue;
+        }
+        int sum = 0;
+        for (int i = 0; i < 256; ++i) {
+            int n = offset[i];
+            offset[i] = sum;
+            sum += n;
+        }
+        for (int i = 0; i < count; ++i) {
+            dst[offset[(src[i].key >> shift) & 0xff]++] = src[i];
+        }
+        RenderSortItem* temp = src;
+        src = dst;
+        dst = temp;
+    }
+    return src;
+}
+
+/*
+  Draw `count` quads from `vertices` with one call.
+*/
+void DrawRenderQuads(SDL_Texture* texture, SDL_Vertex* vertices, int count) {
+    if (count > render_queue.index_quads) {
+        render_queue.indices =
+            realloc(render_queue.indices, 6 * count * sizeof(int));
+        for (int i = render_queue.index_quads; i < count; ++i) {
+            int* index = &render_queue.indices[6 * i];
+            index[0] = 4 * i;
+            index[1] = 4 * i + 1;
+            index[2] = 4 * i + 2;
+            index[3] = 4 * i + 2;
+            index[4] = 4 * i + 3;
+            index[5] = 4 * i;
+        }
+        render_queue.index_quads = count;
+    }
+    SDL_RenderGeometry(
+        game_app.renderer, texture, vertices, 4 * count, render_queue.indices,
+        6 * count
+    );
+}
+
+/*
+  Call it once the window exists and every time its size changes, so that
+  the size does not have to be asked for every frame.
+*/
+void UpdateRenderWindowSize() {
+    SDL_GetWindowSize(
+        game_app.window, &render_queue.window_w, &render_queue.window_h
+    );
+}
+
+/*
+  Draw the layers below `RENDER_LAYER_UI` at `RENDER_VIEW_WIDTH` x
+  `RENDER_VIEW_HEIGHT` and scale them up to the window at once, so that pixel
+  art is drawn without any seams or uneven pixels. The UI is still drawn at
+  the size of the window.
+*/
+void SetFixedRenderView(int enabled) {
+    render_queue.fixed_view = enabled;
+}
+
+/*
+  The size of the area which the world is drawn to, in pixels. It is the
+  window unless the view has a fixed resolution.
+*/
+void GetRenderViewSize(int* w, int* h) {
+    if (render_queue.fixed_view) {
+        *w = RENDER_VIEW_WIDTH;
+        *h = RENDER_VIEW_HEIGHT;
+    } else {
+        *w = render_queue.window_w;
+        *h = render_queue.window_h;
+    }
+}
+
+/*
+  Draw the sorted commands from `begin` to `end`. `color` and `blend` are the
+  current draw color and blend mode of the renderer, which are only changed
+  when a command needs another one.
+*/
+void DrawRenderCommands(
+    RenderSortItem* items, int begin, int end, SDL_Color* color,
+    SDL_BlendMode* blend
+) {
+    int i = begin;
+    while (i < end) {
+        RenderCommand* command = &render_queue.commands[items[i].command];
+        if (command->type != RENDER_COMMAND_QUADS) {
+            if (command->blend != *blend) {
+                *blend = command->blend;
+                SDL_SetRenderDrawBlendMode(game_app.renderer, *blend);
+            }
+            if (memcmp(&command->color, color, sizeof(SDL_Color)) != 0) {
+                *color = command->color;
+                SDL_SetRenderDrawColor(
+                    game_app.renderer, color->r, color->g, color->b, color->a
+                );
+            }
+            if (command->type == RENDER_COMMAND_FILL_RECT) {
+                SDL_RenderFillRectF(game_app.renderer, &command->rect);
+            } else {
+                SDL_RenderDrawRectF(game_app.renderer, &command->rect);
+            }
+            ++i;
+            continue;
+        }
+        // find the run of quads which can be drawn with this one
+        int run_end = i + 1;
+        int count = command->count;
+        while (run_end < end) {
+            RenderCommand* next =
+                &render_queue.commands[items[run_end].command];
+            if (next->type != RENDER_COMMAND_QUADS ||
+                next->texture != command->texture ||
+                next->blend != command->blend) {
+                break;
+            }
+            count += next->count;
+            ++run_end;
+        }
+        SDL_Vertex* vertices = &render_queue.vertices[command->first_vertex];
+        if (run_end - i > 1) {
+            if (4 * count > render_queue.run_capacity) {
+                render_queue.run_capacity = 4 * count;
+                render_queue.run_vertices = realloc(
+                    render_queue.run_vertices,
+                    render_queue.run_capacity * sizeof(SDL_Vertex)
+                );
+            }
+            vertices = render_queue.run_vertices;
+            for (int j = i, n = 0; j < run_end; ++j) {
+                RenderCommand* part = &render_queue.commands[items[j].command];
+                memcpy(
+                    &vertices[n], &render_queue.vertices[part->first_vertex],
+                    4 * part->count * sizeof(SDL_Vertex)
+                );
+                n += 4 * part->count;
+            }
+        }
+        DrawRenderQuads(command->texture, vertices, count);
+        i = run_end;
+    }
+}
+
+/*
+  Copy the fixed view to the middle of the window, scaled by the largest
+  whole number which fits. Whatever is left of the window is a letterbox.
+*/
+void PresentRenderView() {
+    int win_w = render_queue.window_w;
+    int win_h = render_queue.window_h;
+    int scale =
+        SDL_min(win_w / RENDER_VIEW_WIDTH, win_h / RENDER_VIEW_HEIGHT);
+    // the window is never smaller than this, see `SDL_SetWindowMinimumSize`
+    if (scale < 1) {
+        scale = 1;
+    }
+    SDL_Rect dst = {
+        .w = RENDER_VIEW_WIDTH * scale, .h = RENDER_VIEW_HEIGHT * scale
+    };
+    dst.x = (win_w - dst.w) / 2;
+    dst.y = (win_h - dst.h) / 2;
+    SDL_RenderCopy(game_app.renderer, render_queue.view_target, NULL, &dst);
+}
+
+/*
+  Draw the commands of the view to `view_target`, which is created the first
+  time it is needed. Return 0 if it can not be used.
+*/
+int DrawRenderView(
+    RenderSortItem* items, int end, SDL_Color* color, SDL_BlendMode* blend
+) {
+    if (render_queue.view_target == NULL) {
+        render_queue.view_target = SDL_CreateTexture(
+            game_app.renderer, SDL_PIXELFORMAT_RGBA8888,
+            SDL_TEXTUREACCESS_TARGET, RENDER_VIEW_WIDTH, RENDER_VIEW_HEIGHT
+        );
+        if (render_queue.view_target == NULL) {
+            SDL_LogError(
+                SDL_LOG_CATEGORY_ERROR, "SDL_CreateTexture(): %s\n",
+                SDL_GetError()
+            );
+            render_queue.fixed_view = 0;
+            return 0;
+        }
+        SDL_SetTextureBlendMode(render_queue.view_target, SDL_BLENDMODE_NONE);
+    }
+    SDL_Texture* prev_target = SDL_GetRenderTarget(game_app.renderer);
+    SDL_SetRenderTarget(game_app.renderer, render_queue.view_target);
+    *color = (SDL_Color){0, 0, 0, 255};
+    SDL_SetRenderDrawColor(
+        game_app.renderer, color->r, color->g, color->b, color->a
+    );
+    SDL_RenderClear(game_app.renderer);
+    DrawRenderCommands(items, 0, end, color, blend);
+    SDL_SetRenderTarget(game_app.renderer, prev_target);
+    PresentRenderView();
+    return 1;
+}
+
+/*
+  Sort and draw everything submitted since the last flush, once per frame.
+  Consecutive quads with the same texture and blend mode are drawn together,
+  and the draw colour and blend mode are only set when they change.
+*/
+void FlushRenderQueue() {
+    if (render_queue.count == 0 && render_queue.garbage.count == 0) {
+        return;
+    }
+    RenderSortItem* items = SortRenderQueue();
+    SDL_Color prev_color;
+    SDL_BlendMode prev_blend;
+    SDL_GetRenderDrawColor(
+        game_app.renderer, &prev_color.r, &prev_color.g, &prev_color.b,
+        &prev_color.a
+    );
+    SDL_GetRenderDrawBlendMode(game_app.renderer, &prev_blend);
+    SDL_Color color = prev_color;
+    SDL_BlendMode blend = prev_blend;
+    // the queue is sorted by layer, so the view is a prefix of it
+    int view_end = 0;
+    if (render_queue.fixed_view) {
+        while (view_end < render_queue.count &&
+               items[view_end].key >> RENDER_KEY_LAYER_SHIFT <
+                   RENDER_LAYER_UI) {
+            ++view_end;
+        }
+    }
+    if (view_end > 0 && !DrawRenderView(items, view_end, &color, &blend)) {
+        view_end = 0;
+    }
+    DrawRenderCommands(items, view_end, render_queue.count, &color, &blend);
+    SDL_SetRenderDrawColor(
+        game_app.renderer, prev_color.r, prev_color.g, prev_color.b,
+        prev_color.a
+    );
+    SDL_SetRenderDrawBlendMode(game_app.renderer, prev_blend);
+    for (int i = 0; i < render_queue.garbage.count; ++i) {
+        SDL_DestroyTexture(render_queue.garbage.data[i]);
+    }
+    render_queue.garbage.count = 0;
+    render_queue.count = 0;
+    render_queue.vertex_count = 0;
+    memset(render_queue.next_depth, 0, sizeof(render_queue.next_depth));
+}
+
+void FreeRenderQueue() {
+    for (int i = 0; i < render_queue.garbage.count; ++i) {
+        SDL_DestroyTexture(render_queue.garbage.data[i]);
+    }
+    free(render_queue.commands);
+    free(render_queue.items);
+    free(render_queue.sorted);
+    free(render_queue.vertices);
+    free(render_queue.run_vertices);
+    free(render_queue.indices);
+    free(render_queue.garbage.data);
+    if (render_queue.view_target != NULL) {
+        SDL_DestroyTexture(render_queue.view_target);
+    }
+    render_queue = (RenderQueue){};
+}
@@ -21,7 +21,6 @@
 */
 
 #include "../global.h"
-#include "frametimer.h"
 #include "image.h"
 
 extern GameApp game_app;
@@ -35,7 +34,7 @@ Sprite* CreateTextureSprite(SDL_Texture* texture) {
     sprite->area = (SDL_FRect){0, 0, w, h};
     sprite->center = (SDL_FPoint){w / 2.0, h / 2.0};
     sprite->angle = 0.0;
-    sprite->color = (SDL_Color){255, 255, 255};
+    sprite->color = (SDL_Color){255, 255, 255, 255};
     sprite->flip = SDL_FLIP_NONE;
     return sprite;
 }
@@ -43,13 +42,13 @@ Sprite* CreateTextureSprite(SDL_Texture* texture) {
 Sprite* CreateAnimationSprite(Animation* animation) {
     Sprite* sprite = (Sprite*)calloc(1, sizeof(Sprite));
     sprite->type = SPRITE_TYPE_ANIMATION;
-    sprite->image.animation = animation;
+    InitAnimationPlayback(&sprite->image.animation, animation);
     int w = animation->clip[0].area.w;
     int h = animation->clip[0].area.h;
     sprite->area = (SDL_FRect){0, 0, w, h};
     sprite->center = (SDL_FPoint){w / 2.0, h / 2.0};
     sprite->angle = 0.0;
-    sprite->color = (SDL_Color){255, 255, 255};
+    sprite->color = (SDL_Color){255, 255, 255, 255};
     sprite->flip = SDL_FLIP_NONE;
     return sprite;
 }
@@ -58,7 +57,7 @@ void FreeSprite(Sprite* sprite) {
     if (sprite->type == SPRITE_TYPE_TEXTURE) {
         SDL_DestroyTexture(sprite->image.texture);
     } else {
-        FreeAnimation(sprite->image.animation);
+        FreeAnimation((Animation*)sprite->image.animation.animation);
     }
     free(sprite);
 }
@@ -75,42 +74,17 @@ void SetSpriteSize(Sprite* sprite, float w, float h) {
 
 void DrawSprite(Sprite* sprite) {
     if (sprite->type == SPRITE_TYPE_TEXTURE) {
-        SDL_SetTextureColorMod(
-            sprite->image.texture, sprite->color.r, sprite->color.g,
-            sprite->color.b
-        );
-        SDL_SetTextureAlphaMod(sprite->image.texture, sprite->color.a);
-        SDL_RenderCopyExF(
-            game_app.renderer, sprite->image.texture, NULL, &sprite->area,
+        SubmitTextureEx(
+            sprite->image.texture, NULL, &sprite->area, sprite->color,
             sprite->angle, &sprite->center, sprite->flip
         );
     } else {
-        Animation* animation = sprite->image.animation;
-        SDL_SetTextureColorMod(
-            animation->texture, sprite->color.r, sprite->color.g,
-            sprite->color.b
-        );
-        SDL_SetTextureAlphaMod(animation->texture, sprite->color.a);
-        SDL_RenderCopyExF(
-            game_app.renderer, animation->texture,
-            &animation->clip[animation->now_clip].area, &sprite->area,
-            sprite->angle, &sprite->center, sprite->flip
+        AnimationPlayback* playback = &sprite->image.animation;
+        const Animation* animation = playback->animation;
+        SubmitTextureEx(
+            animation->texture, &animation->clip[playback->now_clip].area,
+            &sprite->area, sprite->color, sprite->angle, &sprite->center,
+            sprite->flip
         );
-        if (animation->paused) {
-            animation->dt = 0;
-        } else {
-            animation->dt += frametimer_delta_time(game_app.timer);
-            if (animation->dt > animation->clip[animation->now_clip].duration) {
-                if (animation->now_clip + 1 > animation->count - 1) {
-                    animation->now_clip = 0;
-                    if (animation->on_animation_end) {
-                        animation->on_animation_end(animation->userdata, animation);
-                    }
-                } else {
-                    ++animation->now_clip;
-                }
-                animation->dt = 0;
-            }
-        }
     }
 }
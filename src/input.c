@@ -0,0 +1,257 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "input.h"
+#include "global.h"
+#include "scenes/world.h"
+#include <string.h>
+#include <time.h>
+
+extern GameApp game_app;
+
+InputSystem input_system = {.mode = INPUT_MODE_LIVE};
+// names used by the setting file and the translation keys
+const char* input_action_names[INPUT_ACTION_COUNT] = {
+    "left", "right", "jump", "attack"
+};
+const InputBinding default_input_bindings[INPUT_ACTION_COUNT] = {
+    {SDLK_LEFT, SDL_CONTROLLER_BUTTON_DPAD_LEFT},
+    {SDLK_RIGHT, SDL_CONTROLLER_BUTTON_DPAD_RIGHT},
+    {SDLK_x, SDL_CONTROLLER_BUTTON_A},
+    {SDLK_z, SDL_CONTROLLER_BUTTON_X}
+};
+
+void WriteInputRun() {
+    if (input_system.run.ticks > 0) {
+        fwrite(&input_system.run, sizeof(InputRun), 1, input_system.fp);
+    }
+}
+
+int ReadInputRun() {
+    fread(&input_system.run, sizeof(InputRun), 1, input_system.fp);
+    return !feof(input_system.fp) && !ferror(input_system.fp);
+}
+
+/*
+  Set up recording (`--record <file>`) or replaying (`--replay <file>`) of
+  the simulation input, and return the seed that `srand` should be called
+  with. A replay restores the seed of its recording.
+*/
+unsigned int InitInputSystem(int argc, char* argv[]) {
+    ResetInputBindings();
+    unsigned int seed = (unsigned int)time(NULL);
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--record") == 0) {
+            input_system.fp = fopen(argv[i + 1], "wb");
+            if (!input_system.fp) {
+                SDL_LogError(
+                    SDL_LOG_CATEGORY_ERROR, "cannot write to %s", argv[i + 1]
+                );
+                break;
+            }
+            InputRecordHeader header = {
+                .magic = {'T', 'H', 'I', 'R'},
+                .version = 2,
+                .simulation_rate = TH_SIMULATION_RATE,
+                .seed = seed
+            };
+            fwrite(&header, sizeof(InputRecordHeader), 1, input_system.fp);
+            input_system.mode = INPUT_MODE_RECORD;
+            break;
+        } else if (strcmp(argv[i], "--replay") == 0) {
+            input_system.fp = fopen(argv[i + 1], "rb");
+            if (!input_system.fp) {
+                SDL_LogError(
+                    SDL_LOG_CATEGORY_ERROR, "cannot open %s", argv[i + 1]
+                );
+                break;
+            }
+            InputRecordHeader header;
+            fread(&header, sizeof(InputRecordHeader), 1, input_system.fp);
+            if (feof(input_system.fp) || ferror(input_system.fp) ||
+                strncmp(header.magic, "THIR", 4) != 0 || header.version != 2) {
+                SDL_LogError(
+                    SDL_LOG_CATEGORY_ERROR, "%s is not an input recording",
+                    argv[i + 1]
+                );
+                fclose(input_system.fp);
+                input_system.fp = NULL;
+                break;
+            }
+            if (header.simulation_rate != TH_SIMULATION_RATE) {
+                SDL_LogWarn(
+                    SDL_LOG_CATEGORY_APPLICATION,
+                    "%s was recorded at %d Hz, the replay will diverge",
+                    argv[i + 1], header.simulation_rate
+                );
+            }
+            seed = header.seed;
+            input_system.run.ticks = 0;
+            input_system.mode = INPUT_MODE_REPLAY;
+            break;
+        }
+    }
+    return seed;
+}
+
+void QuitInputSystem() {
+    if (input_system.mode == INPUT_MODE_RECORD) {
+        WriteInputRun();
+    }
+    if (input_system.fp) {
+        fclose(input_system.fp);
+        input_system.fp = NULL;
+    }
+    input_system.mode = INPUT_MODE_LIVE;
+}
+
+void ResetInputBindings() {
+    SDL_memcpy(
+        input_system.bindings, default_input_bindings,
+        sizeof(default_input_bindings)
+    );
+}
+
+/*
+  Forget the actions pressed or held so far, so that a press made in a menu
+  does not carry over to the world.
+*/
+void ResetInput() {
+    input_system.held = 0;
+    input_system.latched = 0;
+    input_system.state = (InputState){0, 0, 0};
+}
+
+Uint8 GetKeyActions(SDL_Keycode key) {
+    Uint8 actions = 0;
+    for (int i = 0; i < INPUT_ACTION_COUNT; ++i) {
+        if (input_system.bindings[i].key == key) {
+            actions |= INPUT_ACTION_BIT(i);
+        }
+    }
+    return actions;
+}
+
+Uint8 GetControllerActions(int button) {
+    Uint8 actions = 0;
+    for (int i = 0; i < INPUT_ACTION_COUNT; ++i) {
+        if (input_system.bindings[i].button == button) {
+            actions |= INPUT_ACTION_BIT(i);
+        }
+    }
+    return actions;
+}
+
+/*
+  Track the live state of the keyboard and controller. This is the only place
+  the simulation input comes from, `UpdateInput` samples it once per tick.
+*/
+void HandleInputEvent(SDL_Event* event) {
+    Uint8 actions = 0;
+    switch (event->type) {
+    case SDL_KEYDOWN:
+        if (event->key.repeat) {
+            break;
+        }
+        actions = GetKeyActions(event->key.keysym.sym);
+        input_system.held |= actions;
+        input_system.latched |= actions;
+        break;
+    case SDL_KEYUP:
+        input_system.held &= ~GetKeyActions(event->key.keysym.sym);
+        break;
+    case SDL_CONTROLLERBUTTONDOWN:
+        actions = GetControllerActions(event->cbutton.button);
+        input_system.held |= actions;
+        input_system.latched |= actions;
+        break;
+    case SDL_CONTROLLERBUTTONUP:
+        input_system.held &= ~GetControllerActions(event->cbutton.button);
+        break;
+    case SDL_CONTROLLERAXISMOTION:
+        if (event->caxis.axis == SDL_CONTROLLER_AXIS_LEFTX) {
+            input_system.axis_x = event->caxis.value;
+        }
+        break;
+    }
+}
+
+/*
+  Quantize the horizontal movement to a signed byte, so that live input and
+  its replay move the same way. The stick wins over digital input when it is
+  out of its dead zone.
+*/
+Sint8 GetMoveX(Uint8 actions) {
+    if (SDL_abs(input_system.axis_x) > INPUT_STICK_DEAD_ZONE) {
+        return SDL_clamp(input_system.axis_x / 256, -127, 127);
+    }
+    int move_x = 0;
+    if (actions & INPUT_ACTION_BIT(INPUT_ACTION_LEFT)) {
+        move_x -= 127;
+    }
+    if (actions & INPUT_ACTION_BIT(INPUT_ACTION_RIGHT)) {
+        move_x += 127;
+    }
+    return move_x;
+}
+
+/*
+  Advance the input by one simulation tick. Live input is recorded if
+  recording, and a replay overrides it. Return 0 when a replay has just
+  ended.
+*/
+int UpdateInput() {
+    Uint8 actions = input_system.held | input_system.latched;
+    Sint8 move_x = GetMoveX(actions);
+    input_system.latched = 0;
+    switch (input_system.mode) {
+    case INPUT_MODE_RECORD:
+        if (input_system.run.ticks > 0 &&
+            (input_system.run.actions != actions ||
+             input_system.run.move_x != move_x ||
+             input_system.run.ticks == UINT16_MAX)) {
+            WriteInputRun();
+            input_system.run.ticks = 0;
+        }
+        input_system.run.actions = actions;
+        input_system.run.move_x = move_x;
+        ++input_system.run.ticks;
+        break;
+    case INPUT_MODE_REPLAY:
+        if (input_system.run.ticks == 0 && !ReadInputRun()) {
+            // the replay is over, hand control back to the devices
+            QuitInputSystem();
+            input_system.state = (InputState){0, 0, 0};
+            return 0;
+        }
+        actions = input_system.run.actions;
+        move_x = input_system.run.move_x;
+        --input_system.run.ticks;
+        break;
+    default:
+        break;
+    }
+    input_system.state.pressed = actions & ~input_system.state.actions;
+    input_system.state.actions = actions;
+    input_system.state.move_x = move_x / 127.0f;
+    return 1;
+}
@@ -0,0 +1,114 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef TH_INPUT_H_
+#define TH_INPUT_H_
+
+#include <SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+  Actions the simulation understands. Each one can be bound to a key and a
+  controller button in the setting.
+*/
+typedef enum InputAction {
+    INPUT_ACTION_LEFT,
+    INPUT_ACTION_RIGHT,
+    INPUT_ACTION_JUMP,
+    INPUT_ACTION_ATTACK,
+    INPUT_ACTION_COUNT
+} InputAction;
+
+#define INPUT_ACTION_BIT(action) (1 << (action))
+#define INPUT_STICK_DEAD_ZONE 8000
+
+typedef struct InputBinding {
+    SDL_Keycode key;
+    SDL_GameControllerButton button;
+} InputBinding;
+
+// please note this alignment
+#pragma pack(1)
+
+/*
+  An input recording is this header followed by runs of identical ticks, each
+  stored as `InputRun`.
+*/
+typedef struct InputRecordHeader {
+    char magic[4];
+    uint8_t version;
+    uint16_t simulation_rate;
+    uint32_t seed;
+} InputRecordHeader;
+
+typedef struct InputRun {
+    uint8_t actions;
+    int8_t move_x;
+    uint16_t ticks;
+} InputRun;
+
+#pragma pack()
+
+/*
+  Input of one simulation tick. `actions` is a bitmask of `INPUT_ACTION_BIT`,
+  `pressed` holds the actions which went down since the previous tick and
+  `move_x` is the horizontal movement in [-1, 1].
+*/
+typedef struct InputState {
+    Uint8 actions;
+    Uint8 pressed;
+    float move_x;
+} InputState;
+
+typedef enum InputMode {
+    INPUT_MODE_LIVE,
+    INPUT_MODE_RECORD,
+    INPUT_MODE_REPLAY
+} InputMode;
+
+typedef struct InputSystem {
+    InputMode mode;
+    InputState state;
+    InputBinding bindings[INPUT_ACTION_COUNT];
+    // actions currently held on the keyboard and controller
+    Uint8 held;
+    // actions which were pressed since the last tick, so that a tap shorter
+    // than a tick is not lost
+    Uint8 latched;
+    // position of the left stick of the controller
+    Sint16 axis_x;
+    FILE* fp;
+    InputRun run;
+} InputSystem;
+
+extern InputSystem input_system;
+extern const char* input_action_names[INPUT_ACTION_COUNT];
+
+unsigned int InitInputSystem(int argc, char* argv[]);
+void QuitInputSystem();
+void ResetInputBindings();
+void ResetInput();
+void HandleInputEvent(SDL_Event* event);
+int UpdateInput();
+
+#endif
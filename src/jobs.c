@@ -0,0 +1,214 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+/*
+  A small work-stealing job system.
+
+  `ParallelFor` pushes the whole loop as one range. Whoever takes a range
+  larger than the grain splits off its upper half onto its own deque, and idle
+  workers steal from the top of the other deques. Ranges are always split at
+  multiples of the grain, so the leaf ranges are the same on every run.
+*/
+
+#include "jobs.h"
+#include <stdint.h>
+
+#if !defined(SDL_CPUPauseInstruction)
+    // added in SDL 2.24
+    #define SDL_CPUPauseInstruction()
+#endif
+
+JobSystem job_system;
+
+#if defined(TH_THREADED_JOBS)
+int PushJob(JobDeque* deque, JobRange range) {
+    int b = SDL_AtomicGet(&deque->bottom);
+    int t = SDL_AtomicGet(&deque->top);
+    if (b - t >= JOB_DEQUE_SIZE) {
+        return 0;
+    }
+    deque->ranges[b & (JOB_DEQUE_SIZE - 1)] = range;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&deque->bottom, b + 1);
+    return 1;
+}
+
+int PopJob(JobDeque* deque, JobRange* range) {
+    int b = SDL_AtomicGet(&deque->bottom) - 1;
+    SDL_AtomicSet(&deque->bottom, b);
+    // a full barrier, the store above must be visible before `top` is read
+    int t = SDL_AtomicAdd(&deque->top, 0);
+    if (t > b) {
+        SDL_AtomicSet(&deque->bottom, b + 1);
+        return 0;
+    }
+    *range = deque->ranges[b & (JOB_DEQUE_SIZE - 1)];
+    if (t == b) {
+        // the last range, race the thieves for it
+        int won = SDL_AtomicCAS(&deque->top, t, t + 1);
+        SDL_AtomicSet(&deque->bottom, b + 1);
+        return won;
+    }
+    return 1;
+}
+
+int StealJob(JobDeque* deque, JobRange* range) {
+    int t = SDL_AtomicGet(&deque->top);
+    int b = SDL_AtomicGet(&deque->bottom);
+    if (t >= b) {
+        return 0;
+    }
+    *range = deque->ranges[t & (JOB_DEQUE_SIZE - 1)];
+    return SDL_AtomicCAS(&deque->top, t, t + 1);
+}
+
+/*
+  Run `range` on worker `id`, splitting it down to the grain.
+*/
+void RunJob(int id, JobRange range) {
+    int grain = job_system.grain;
+    while (range.end - range.begin > grain) {
+        int chunks = (range.end - range.begin + grain - 1) / grain;
+        int mid = range.begin + chunks / 2 * grain;
+        if (!PushJob(&job_system.deques[id], (JobRange){mid, range.end})) {
+            break;
+        }
+        range.end = mid;
+    }
+    job_system.fn(job_system.data, range.begin, range.end);
+    SDL_AtomicAdd(&job_system.remaining, -(range.end - range.begin));
+}
+
+/*
+  Take ranges from the own deque first, then from the others, until the loop
+  is finished. A worker with nothing to take spins for a while, then yields
+  to the threads still running the last ranges.
+*/
+void WorkUntilDone(int id) {
+    int deque_count = job_system.worker_count + 1;
+    int spins = 0;
+    while (SDL_AtomicGet(&job_system.remaining) > 0) {
+        JobRange range;
+        int found = PopJob(&job_system.deques[id], &range);
+        for (int i = 1; !found && i < deque_count; ++i) {
+            found = StealJob(
+                &job_system.deques[(id + i) % deque_count], &range
+            );
+        }
+        if (found) {
+            RunJob(id, range);
+            spins = 0;
+        } else if (++spins < JOB_SPINS_BEFORE_YIELD) {
+            SDL_CPUPauseInstruction();
+        } else {
+            SDL_Delay(0);
+            spins = 0;
+        }
+    }
+}
+
+int JobWorker(void* data) {
+    int id = (int)(intptr_t)data;
+    while (1) {
+        SDL_SemWait(job_system.wake);
+        if (SDL_AtomicGet(&job_system.quit)) {
+            break;
+        }
+        WorkUntilDone(id);
+    }
+    return 0;
+}
+#endif
+
+/*
+  Start one worker for every core but the one of the calling thread. Without
+  `TH_THREADED_JOBS`, or if no thread can be created, `ParallelFor` runs on
+  the calling thread.
+*/
+void InitJobSystem() {
+    job_system.worker_count = 0;
+#if defined(TH_THREADED_JOBS)
+    SDL_AtomicSet(&job_system.quit, 0);
+    job_system.wake = SDL_CreateSemaphore(0);
+    if (!job_system.wake) {
+        return;
+    }
+    int count = SDL_clamp(SDL_GetCPUCount() - 1, 0, MAX_JOB_WORKERS);
+    for (int i = 0; i < count; ++i) {
+        // worker `i + 1` owns deque `i + 1`
+        SDL_Thread* thread =
+            SDL_CreateThread(JobWorker, "job", (void*)(intptr_t)(i + 1));
+        if (!thread) {
+            break;
+        }
+        job_system.workers[job_system.worker_count++] = thread;
+    }
+#endif
+}
+
+void QuitJobSystem() {
+#if defined(TH_THREADED_JOBS)
+    SDL_AtomicSet(&job_system.quit, 1);
+    for (int i = 0; i < job_system.worker_count; ++i) {
+        SDL_SemPost(job_system.wake);
+    }
+    for (int i = 0; i < job_system.worker_count; ++i) {
+        SDL_WaitThread(job_system.workers[i], NULL);
+    }
+    if (job_system.wake) {
+        SDL_DestroySemaphore(job_system.wake);
+        job_system.wake = NULL;
+    }
+#endif
+    job_system.worker_count = 0;
+}
+
+int GetJobWorkerCount() {
+    return job_system.worker_count;
+}
+
+/*
+  Call `fn` on ranges covering [0, count) and return when all of them are
+  done. Each range is a whole number of `grain` sized chunks, and the ranges
+  may run at the same time on different threads. Only one loop can run at a
+  time, so `fn` must not call `ParallelFor`.
+*/
+void ParallelFor(int count, int grain, JobFunction fn, void* data) {
+    if (count <= 0) {
+        return;
+    }
+#if defined(TH_THREADED_JOBS)
+    if (job_system.worker_count > 0 && count > grain) {
+        job_system.fn = fn;
+        job_system.data = data;
+        job_system.grain = grain;
+        SDL_AtomicSet(&job_system.remaining, count);
+        PushJob(&job_system.deques[0], (JobRange){0, count});
+        for (int i = 0; i < job_system.worker_count; ++i) {
+            SDL_SemPost(job_system.wake);
+        }
+        WorkUntilDone(0);
+        return;
+    }
+#endif
+    fn(data, 0, count);
+}
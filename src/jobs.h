@@ -0,0 +1,77 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef TH_JOBS_H_
+#define TH_JOBS_H_
+
+#include <SDL.h>
+
+#define MAX_JOB_WORKERS 8
+// must be a power of two
+#define JOB_DEQUE_SIZE 256
+// failed rounds of stealing before a worker gives up its time slice
+#define JOB_SPINS_BEFORE_YIELD 64
+
+/*
+  Process items [begin, end) of a parallel loop.
+*/
+typedef void (*JobFunction)(void* data, int begin, int end);
+
+typedef struct JobRange {
+    int begin;
+    int end;
+} JobRange;
+
+/*
+  Chase-Lev deque: its owner pushes and pops at the bottom, other workers
+  steal from the top.
+*/
+typedef struct JobDeque {
+    SDL_atomic_t top;
+    SDL_atomic_t bottom;
+    JobRange ranges[JOB_DEQUE_SIZE];
+} JobDeque;
+
+/*
+  Worker threads which split the loop of `ParallelFor` between them. Deque 0
+  belongs to the thread which calls `ParallelFor`, deque `i` to worker `i`.
+*/
+typedef struct JobSystem {
+    int worker_count;
+    SDL_Thread* workers[MAX_JOB_WORKERS];
+    JobDeque deques[MAX_JOB_WORKERS + 1];
+    SDL_sem* wake;
+    SDL_atomic_t quit;
+    // the loop which is running
+    JobFunction fn;
+    void* data;
+    int grain;
+    // items of the loop which are not finished yet
+    SDL_atomic_t remaining;
+} JobSystem;
+
+void InitJobSystem();
+void QuitJobSystem();
+int GetJobWorkerCount();
+void ParallelFor(int count, int grain, JobFunction fn, void* data);
+
+#endif
@@ -22,7 +22,12 @@
 
 #include "entities/base.h"
 #include "global.h"
+#include "headless.h"
+#include "image/image.h"
+#include "input.h"
+#include "jobs.h"
 #include "map.h"
+#include "particles.h"
 #include "resource/loader.h"
 #include "scenes/setting_menu.h"
 #include "scenes/start_menu.h"
@@ -39,11 +44,6 @@
     #include <Windows.h>
 #endif
 
-#define CUTE_TILED_IMPLEMENTATION
-#include "cute_tiled.h"
-#define FRAMETIMER_IMPLEMENTATION
-#include "frametimer.h"
-
 GameApp game_app = {
     .status = GAMESTATUS_NORMAL,
     .joystick = {.available = 0, .which = INT_MIN},
@@ -53,6 +53,7 @@ GameApp game_app = {
 Setting game_setting = {
 #if !defined(__PSP__) && !defined(__vita__)
     .fullscreen = 0,
+    .pixel_perfect = 0,
 #endif
 #if !defined(__PSP__)
     .language = NULL,
@@ -69,15 +70,19 @@ Setting game_setting = {
 // main function for Linux
 int main(int argc, char* argv[]) {
     int retval = EXIT_SUCCESS;
-    srand((unsigned)time(NULL));
+    // `--record` and `--replay` make a run reproducible, including its seed
+    srand(InitInputSystem(argc, argv));
+    // `--headless` runs the simulation only, without any video or audio device
+    int headless = IsHeadlessMode(argc, argv);
 
     // initialise SDL, SDL_image, SDL_mixer and SDL_ttf
-    if (SDL_Init(SDL_INIT_EVERYTHING) < 0) {
+    if (SDL_Init(headless ? SDL_INIT_TIMER : SDL_INIT_EVERYTHING) < 0) {
         SDL_LogError(
             SDL_LOG_CATEGORY_ERROR, "SDL_Init(): %s\n", SDL_GetError()
         );
         return 1;
     }
+    InitJobSystem();
     SDL_SetHint(SDL_HINT_APP_NAME, "Treasure Hunters");
     SDL_SetHint(SDL_HINT_AUDIO_DEVICE_APP_NAME, "Treasure Hunters");
     SDL_SetHint(SDL_HINT_RENDER_VSYNC, "1");
@@ -86,17 +91,21 @@ int main(int argc, char* argv[]) {
         SDL_LogError(
             SDL_LOG_CATEGORY_ERROR, "IMG_Init(): %s\n", SDL_GetError()
         );
+        QuitJobSystem();
         return 1;
     }
-    if (Mix_Init(MIX_INIT_OGG) != MIX_INIT_OGG) {
+    if (!headless && Mix_Init(MIX_INIT_OGG) != MIX_INIT_OGG) {
         SDL_LogError(
             SDL_LOG_CATEGORY_ERROR, "Mix_Init(): %s\n", SDL_GetError()
         );
+        QuitJobSystem();
         return 1;
     }
-    Mix_OpenAudio(48000, AUDIO_S16SYS, 2, 2048);
+    if (!headless) {
+        Mix_OpenAudio(48000, AUDIO_S16SYS, 2, 2048);
+    }
 #if !defined(TH_FALLBACK_TO_BITMAP_FONT)
-    if (TTF_Init() != 0) {
+    if (!headless && TTF_Init() != 0) {
         SDL_LogError(
             SDL_LOG_CATEGORY_ERROR, "TTF_Init(): %s\n", SDL_GetError()
         );
@@ -130,6 +139,11 @@ int main(int argc, char* argv[]) {
         goto rpkg_not_found;
     }
     free(rpkg_path);
+    if (headless) {
+        retval = RunHeadless(argc, argv);
+        FreeRespack(game_app.assets_pack);
+        goto rpkg_not_found;
+    }
 
     // create the window, renderer and set the window icon
 #if defined(__PSP__)
@@ -147,6 +161,7 @@ int main(int argc, char* argv[]) {
         SDL_LogError(
             SDL_LOG_CATEGORY_ERROR, "SDL_CreateWindow(): %s\n", SDL_GetError()
         );
+        QuitJobSystem();
         return 1;
     }
 #if !defined(__PSP__) && !defined(__vita__)
@@ -161,6 +176,7 @@ int main(int argc, char* argv[]) {
     );
     SDL_RenderSetVSync(game_app.renderer, 1);
     SDL_SetRenderDrawBlendMode(game_app.renderer, SDL_BLENDMODE_BLEND);
+    UpdateRenderWindowSize();
 
     // restore previous settings
     InitSetting();
@@ -173,6 +189,7 @@ int main(int argc, char* argv[]) {
     );
 #else
     SDL_SetWindowFullscreen(game_app.window, game_setting.fullscreen);
+    SetFixedRenderView(game_setting.pixel_perfect);
     Mix_Volume(MUSIC_CHANNEL, game_setting.music_volume);
     Mix_Volume(SFX_CHANNEL, game_setting.sfx_volume);
 #endif
@@ -183,6 +200,7 @@ int main(int argc, char* argv[]) {
     scene_array[WORLD_SCENE] = &world_scene;
     InitEntitySystem();
     InitMapSystem();
+    InitParticleSystem();
     InitSceneSystem();
     InitTranslation();
     InitUISystem();
@@ -197,13 +215,28 @@ int main(int argc, char* argv[]) {
 
     // game loop
     game_app.timer = frametimer_create(NULL);
-    frametimer_lock_rate(game_app.timer, 60);
+    frametimer_lock_rate(game_app.timer, FULL_FRAME_RATE);
+    Uint32 frame_start = SDL_GetTicks();
     while (!game_app.should_quit) {
+        // a frame below the full rate sleeps until its time or until the next
+        // event, whichever comes first, so input is still answered at once
+        int frame_rate = GetSceneFrameRate();
+        if (frame_rate < FULL_FRAME_RATE) {
+            Uint32 elapsed = SDL_GetTicks() - frame_start;
+            if (elapsed < 1000 / frame_rate) {
+                SDL_WaitEventTimeout(NULL, 1000 / frame_rate - elapsed);
+            }
+        }
         float dt = frametimer_update(game_app.timer);
+        frame_start = SDL_GetTicks();
+        game_app.clock += dt;
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
             switch (event.type) {
             case SDL_WINDOWEVENT:
+                if (event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+                    UpdateRenderWindowSize();
+                }
 #if !defined(__PSP__) && !defined(__vita__)
                 if (event.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
                     game_app.window_focused = 0;
@@ -254,12 +287,18 @@ int main(int argc, char* argv[]) {
                 game_app.should_quit = 1;
                 break;
             }
-            HandleWidgetEvent(&event);
+            HandleInputEvent(&event);
+            // the button which is being bound must not click a widget
+            if (game_app.status != GAMESTATUS_KEY_BINDING ||
+                event.type != SDL_CONTROLLERBUTTONDOWN) {
+                HandleWidgetEvent(&event);
+            }
             HandleSceneEvent(&event);
         }
         SDL_RenderClear(game_app.renderer);
         TickWidgets(dt);
         TickScene(dt);
+        FlushRenderQueue();
         SDL_RenderPresent(game_app.renderer);
     }
 
@@ -269,11 +308,13 @@ int main(int argc, char* argv[]) {
         SDL_GameControllerClose(game_app.joystick.device);
     }
     SaveSetting();
+    QuitParticleSystem();
     QuitMapSystem();
     QuitEntitySystem();
     QuitSceneSystem();
     QuitTranslation();
     QuitUISystem();
+    FreeRenderQueue();
 #if !defined(__PSP__) && !defined(__vita__)
     SDL_FreeSurface(icon_image);
 #endif
@@ -281,6 +322,8 @@ int main(int argc, char* argv[]) {
     SDL_DestroyWindow(game_app.window);
     FreeRespack(game_app.assets_pack);
 rpkg_not_found:
+    QuitJobSystem();
+    QuitInputSystem();
     free(game_app.exec_path);
 #if !defined(TH_FALLBACK_TO_BITMAP_FONT)
     TTF_Quit();
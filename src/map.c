@@ -23,27 +23,114 @@
 #include "map.h"
 #include "entities/player.h"
 #include "global.h"
+#include "image/image.h"
 #include "resource/loader.h"
+#include <float.h>
 #include <stdlib.h>
 
+#define MAP_ARENA_MIN_BLOCK_SIZE (64 * 1024)
+// clean tiles a dirty rectangle may take in to cover one more tile
+#define DIRTY_RECT_MAX_WASTE 16
+
 extern GameApp game_app;
 
 SDL_Texture* terrains_texture = NULL;
+TileMask* terrains_mask = NULL;
+#if defined(TH_THREADED_MAP_BAKE)
+SDL_Surface* terrains_surface = NULL;
+#endif
+
+TileMask* LoadTileMask(char* filename) {
+    size_t size;
+    uint8_t* content = GetRespackItem(game_app.assets_pack, filename, &size);
+    if (size < sizeof(TileMaskHeader)) {
+        free(content);
+        return NULL;
+    }
+    TileMaskHeader header;
+    memcpy(&header, content, sizeof(TileMaskHeader));
+    size_t word_count =
+        header.tile_count * header.tile_height * header.words_per_row;
+    if (strncmp(header.magic, "TMSK", 4) != 0 || header.version != 1 ||
+        size < sizeof(TileMaskHeader) + word_count * sizeof(uint64_t)) {
+        free(content);
+        return NULL;
+    }
+    TileMask* mask = calloc(1, sizeof(TileMask));
+    mask->tile_width = header.tile_width;
+    mask->tile_height = header.tile_height;
+    mask->tile_count = header.tile_count;
+    mask->words_per_row = header.words_per_row;
+    mask->bits = calloc(word_count, sizeof(uint64_t));
+    memcpy(
+        mask->bits, content + sizeof(TileMaskHeader),
+        word_count * sizeof(uint64_t)
+    );
+    free(content);
+    mask->bounds = calloc(mask->tile_count, sizeof(SDL_Rect));
+    for (int tile = 0; tile < mask->tile_count; ++tile) {
+        int x0 = mask->tile_width, y0 = mask->tile_height, x1 = -1, y1 = -1;
+        for (int y = 0; y < mask->tile_height; ++y) {
+            for (int x = 0; x < mask->tile_width; ++x) {
+                uint64_t word =
+                    mask->bits[(tile * mask->tile_height + y) *
+                                   mask->words_per_row +
+                               x / 64];
+                if (word >> (x % 64) & 1) {
+                    x0 = SDL_min(x0, x);
+                    y0 = SDL_min(y0, y);
+                    x1 = SDL_max(x1, x);
+                    y1 = SDL_max(y1, y);
+                }
+            }
+        }
+        if (x1 >= 0) {
+            mask->bounds[tile] = (SDL_Rect){x0, y0, x1 - x0 + 1, y1 - y0 + 1};
+        }
+    }
+    return mask;
+}
+
+void FreeTileMask(TileMask* mask) {
+    if (mask) {
+        free(mask->bits);
+        free(mask->bounds);
+        free(mask);
+    }
+}
 
 void InitMapSystem() {
+    terrains_mask = LoadTileMask("maps/tilesets/terrains.mask");
+    if (!game_app.renderer) {
+        // headless mode, only collision data is needed
+        return;
+    }
     terrains_texture = LoadTexture("maps/tilesets/terrains.png");
+#if defined(TH_THREADED_MAP_BAKE)
+    SDL_Surface* surface = LoadSurface("maps/tilesets/terrains.png");
+    if (surface) {
+        terrains_surface =
+            SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+        SDL_FreeSurface(surface);
+    }
+#endif
 }
 
 void QuitMapSystem() {
     SDL_DestroyTexture(terrains_texture);
+    FreeTileMask(terrains_mask);
+#if defined(TH_THREADED_MAP_BAKE)
+    SDL_FreeSurface(terrains_surface);
+#endif
 }
 
-SDL_Texture*
-GetTextureRegionFromGID(Map* map, int gid, int* flip, SDL_Rect* rect) {
+Tileset* GetTilesetRegionFromGID(Map* map, int gid, int* flip, SDL_Rect* rect) {
+    // the top bits of `gid` are the flips of the tile
+    int id = cute_tiled_unset_flags(gid);
     for (Tileset* tileset = map->tilemap->tilesets; tileset;
          tileset = tileset->next) {
-        if (tileset->firstgid <= gid &&
-            tileset->firstgid + tileset->tilecount > gid) {
+        if (tileset->firstgid <= id &&
+            tileset->firstgid + tileset->tilecount > id) {
             int hflip, vflip, dflip, flip_temp = SDL_FLIP_NONE;
             cute_tiled_get_flags(gid, &hflip, &vflip, &dflip);
             if (hflip) {
@@ -59,197 +146,601 @@ GetTextureRegionFromGID(Map* map, int gid, int* flip, SDL_Rect* rect) {
             rect->y = local_id / dw * tileset->tileheight;
             rect->w = tileset->tilewidth;
             rect->h = tileset->tileheight;
-            if (strcmp(tileset->image.ptr, "terrains.png") == 0) {
-                return terrains_texture;
-            }
+            return tileset;
         }
     }
     return NULL;
 }
 
-void CreateCollisionRectList(Map* map) {
-    struct {
-        int gid;
-        int has_damage;
-        int damage;
-        int has_collision;
-        SDL_Rect collision;
-    } special_tile_cache[16];
-    int special_tile_count = 0;
+SDL_Texture*
+GetTextureRegionFromGID(Map* map, int gid, int* flip, SDL_Rect* rect) {
+    Tileset* tileset = GetTilesetRegionFromGID(map, gid, flip, rect);
+    if (tileset && strcmp(tileset->image.ptr, "terrains.png") == 0) {
+        return terrains_texture;
+    }
+    return NULL;
+}
+
+/*
+  Get the pixel mask of tile `gid`. `flip` is filled with `SDL_RendererFlip`
+  flags of the tile, plus `TILE_FLIP_DIAGONAL`. As in Tiled, a diagonal flip
+  swaps x and y of the tile before the horizontal and vertical flips.
+*/
+uint64_t* GetTileMaskFromGID(Map* map, int gid, int* flip, SDL_Rect* bounds) {
+    SDL_Rect rect;
+    Tileset* tileset = GetTilesetRegionFromGID(map, gid, flip, &rect);
+    if (!tileset || !terrains_mask ||
+        strcmp(tileset->image.ptr, "terrains.png") != 0) {
+        return NULL;
+    }
+    int local_id = cute_tiled_unset_flags(gid) - tileset->firstgid;
+    if (local_id >= terrains_mask->tile_count ||
+        terrains_mask->tile_width != map->tilemap->tilewidth ||
+        terrains_mask->tile_height != map->tilemap->tileheight) {
+        return NULL;
+    }
+    int hflip, vflip, dflip;
+    cute_tiled_get_flags(gid, &hflip, &vflip, &dflip);
+    *bounds = terrains_mask->bounds[local_id];
+    if (dflip) {
+        if (terrains_mask->tile_width != terrains_mask->tile_height) {
+            // only a square tile can be flipped along its diagonal
+            return NULL;
+        }
+        *flip |= TILE_FLIP_DIAGONAL;
+        *bounds = (SDL_Rect){bounds->y, bounds->x, bounds->h, bounds->w};
+    }
+    if (*flip & SDL_FLIP_HORIZONTAL) {
+        bounds->x = terrains_mask->tile_width - bounds->x - bounds->w;
+    }
+    if (*flip & SDL_FLIP_VERTICAL) {
+        bounds->y = terrains_mask->tile_height - bounds->y - bounds->h;
+    }
+    return &terrains_mask->bits[local_id * terrains_mask->tile_height *
+                                terrains_mask->words_per_row];
+}
+
+#if defined(TH_THREADED_MAP_BAKE)
+SDL_Surface*
+GetSurfaceRegionFromGID(Map* map, int gid, int* flip, SDL_Rect* rect) {
+    Tileset* tileset = GetTilesetRegionFromGID(map, gid, flip, rect);
+    if (tileset && strcmp(tileset->image.ptr, "terrains.png") == 0) {
+        return terrains_surface;
+    }
+    return NULL;
+}
+#endif
+
+int IsLayerInGroup(TilemapLayer* layer, TilemapLayerGroup group) {
+    if (strcmp(layer->type.ptr, "tilelayer") != 0) {
+        return 0;
+    }
+    switch (group) {
+    case TILEMAP_LAYERGROUP_FRONT:
+        return strncmp(layer->name.ptr, "front", 5) == 0;
+    case TILEMAP_LAYERGROUP_MIDDLE:
+        return strncmp(layer->name.ptr, "middle", 6) == 0;
+    case TILEMAP_LAYERGROUP_BACK:
+        return strncmp(layer->name.ptr, "back", 4) == 0;
+    }
+    return 0;
+}
+
+void CreateTilePropertyList(Map* map) {
+    int count = 0;
     for (Tileset* tileset = map->tilemap->tilesets; tileset;
          tileset = tileset->next) {
         for (TileDescriptor* info = tileset->tiles; info; info = info->next) {
-            special_tile_cache[special_tile_count].gid =
-                tileset->firstgid + info->tile_index;
+            ++count;
+        }
+    }
+    map->tile_properties.count = 0;
+    map->tile_properties.data =
+        ArenaCalloc(map->arena, count + 1, sizeof(TileProperty));
+    for (Tileset* tileset = map->tilemap->tilesets; tileset;
+         tileset = tileset->next) {
+        for (TileDescriptor* info = tileset->tiles; info; info = info->next) {
+            TileProperty* now =
+                &map->tile_properties.data[map->tile_properties.count++];
+            now->gid = tileset->firstgid + info->tile_index;
             for (int i = 0; i < info->property_count; ++i) {
                 TilemapProperty prop = info->properties[i];
                 if (strcmp(prop.name.ptr, "has_damage") == 0 &&
                     prop.type == CUTE_TILED_PROPERTY_BOOL) {
-                    special_tile_cache[special_tile_count].has_damage =
-                        prop.data.boolean;
+                    now->has_damage = prop.data.boolean;
                 } else if (strcmp(prop.name.ptr, "damage") == 0 &&
                            prop.type == CUTE_TILED_PROPERTY_INT) {
-                    special_tile_cache[special_tile_count].damage =
-                        prop.data.integer;
+                    now->damage = prop.data.integer;
                 }
             }
-            if (info->objectgroup->objects) {
+            if (info->objectgroup && info->objectgroup->objects) {
                 TilemapObject* obj = info->objectgroup->objects;
-                special_tile_cache[special_tile_count].has_collision = 1;
-                special_tile_cache[special_tile_count].collision =
+                now->has_collision = 1;
+                now->collision =
                     (SDL_Rect){obj->x, obj->y, obj->width, obj->height};
             }
-            ++special_tile_count;
         }
     }
-    map->collision_list = calloc(1, sizeof(CollisionRectNode));
-    map->collision_list->next = NULL;
+}
+
+TileProperty* GetTileProperty(Map* map, int gid) {
+    int id = cute_tiled_unset_flags(gid);
+    for (int i = 0; i < map->tile_properties.count; ++i) {
+        if (map->tile_properties.data[i].gid == id) {
+            return &map->tile_properties.data[i];
+        }
+    }
+    return NULL;
+}
+
+int TileMaskIsSolid(CollisionShape* shape, int x, int y) {
+    if (shape->mask_flip & SDL_FLIP_HORIZONTAL) {
+        x = terrains_mask->tile_width - 1 - x;
+    }
+    if (shape->mask_flip & SDL_FLIP_VERTICAL) {
+        y = terrains_mask->tile_height - 1 - y;
+    }
+    if (shape->mask_flip & TILE_FLIP_DIAGONAL) {
+        int temp = x;
+        x = y;
+        y = temp;
+    }
+    uint64_t word = shape->mask[y * terrains_mask->words_per_row + x / 64];
+    return word >> (x % 64) & 1;
+}
+
+/*
+  Get the shape of tile `gid` at (x, y). A tile with a collision object in its
+  tileset uses that rectangle, other tiles use their pixel masks. Return 0 if
+  the tile has nothing to collide with.
+*/
+int GetTileShape(Map* map, int gid, int x, int y, CollisionShape* shape) {
+    *shape = (CollisionShape){
+        {x * map->tilemap->tilewidth, y * map->tilemap->tileheight,
+         map->tilemap->tilewidth, map->tilemap->tileheight},
+        NULL, 0, NULL
+    };
+    TileProperty* prop = GetTileProperty(map, gid);
+    if (prop && prop->has_collision) {
+        shape->rect.x += prop->collision.x;
+        shape->rect.y += prop->collision.y;
+        shape->rect.w = prop->collision.w;
+        shape->rect.h = prop->collision.h;
+        return !SDL_RectEmpty(&shape->rect);
+    }
+    SDL_Rect bounds;
+    shape->mask = GetTileMaskFromGID(map, gid, &shape->mask_flip, &bounds);
+    if (shape->mask) {
+        shape->rect.x += bounds.x;
+        shape->rect.y += bounds.y;
+        shape->rect.w = bounds.w;
+        shape->rect.h = bounds.h;
+    }
+    return !SDL_RectEmpty(&shape->rect);
+}
+
+/*
+  Set the pixels of `shape` in `bits`, a mask of the tile whose top left
+  corner is at (ox, oy) in the world.
+*/
+void DrawShapeToMask(CollisionShape* shape, int ox, int oy, uint64_t* bits) {
+    int words_per_row = terrains_mask->words_per_row;
+    SDL_Rect tile = {
+        ox, oy, terrains_mask->tile_width, terrains_mask->tile_height
+    };
+    SDL_Rect area;
+    if (!SDL_IntersectRect(&shape->rect, &tile, &area)) {
+        return;
+    }
+    for (int y = area.y - oy; y < area.y + area.h - oy; ++y) {
+        for (int x = area.x - ox; x < area.x + area.w - ox; ++x) {
+            if (!shape->mask || TileMaskIsSolid(shape, x, y)) {
+                bits[y * words_per_row + x / 64] |= (uint64_t)1 << (x % 64);
+            }
+        }
+    }
+}
+
+/*
+  Add `shape` of the tile at (x, y) to `into`, which is empty unless `is_set`.
+  Two shapes are merged into one pixel mask owned by `into`, or into their
+  bounding box if there are no pixel masks.
+*/
+void AddCollisionShape(
+    Map* map, CollisionShape* into, int is_set, CollisionShape* shape, int x,
+    int y
+) {
+    uint64_t* merged = into->merged;
+    if (!is_set) {
+        *into = *shape;
+        into->merged = merged;
+        return;
+    }
+    int ox = x * map->tilemap->tilewidth;
+    int oy = y * map->tilemap->tileheight;
+    SDL_Rect bounds;
+    SDL_UnionRect(&into->rect, &shape->rect, &bounds);
+    if (!terrains_mask ||
+        terrains_mask->tile_width != map->tilemap->tilewidth ||
+        terrains_mask->tile_height != map->tilemap->tileheight) {
+        into->rect = bounds;
+        into->mask = NULL;
+        return;
+    }
+    size_t words = terrains_mask->tile_height * terrains_mask->words_per_row;
+    if (!merged) {
+        merged = ArenaAlloc(map->arena, words * sizeof(uint64_t));
+        into->merged = merged;
+    }
+    if (!merged) {
+        into->rect = bounds;
+        into->mask = NULL;
+        return;
+    }
+    if (into->mask != merged) {
+        memset(merged, 0, words * sizeof(uint64_t));
+        DrawShapeToMask(into, ox, oy, merged);
+    }
+    DrawShapeToMask(shape, ox, oy, merged);
+    SDL_Rect tile = {
+        ox, oy, map->tilemap->tilewidth, map->tilemap->tileheight
+    };
+    SDL_IntersectRect(&bounds, &tile, &into->rect);
+    into->mask = merged;
+    into->mask_flip = SDL_FLIP_NONE;
+}
+
+/*
+  Calculate the collision cell at (x, y) from all middle layers. Tiles on top
+  of each other add up: the cell is solid where any tile without damage is,
+  and hurts where any damaging tile is.
+*/
+void UpdateCollisionCell(Map* map, int x, int y) {
+    CollisionCell* cell = &map->collision.cells[y * map->collision.width + x];
+    cell->is_solid = 0;
+    cell->has_damage = 0;
+    cell->damage = 0;
     for (TilemapLayer* layer = map->tilemap->layers; layer;
          layer = layer->next) {
-        if (strncmp(layer->name.ptr, "middle", 6) != 0) {
+        if (!IsLayerInGroup(layer, TILEMAP_LAYERGROUP_MIDDLE)) {
             continue;
         }
-        for (int i = 0; i < layer->data_count; ++i) {
-            if (layer->data[i] == 0) {
-                continue;
-            }
-            int x = i % layer->width;
-            int y = i / layer->width;
-            SDL_Rect dstrect = {
-                x * map->tilemap->tilewidth, y * map->tilemap->tileheight,
-                map->tilemap->tilewidth, map->tilemap->tileheight
-            };
-            CollisionRectNode* node = calloc(1, sizeof(CollisionRectNode));
-            node->has_damage = 0;
-            for (int now = 0; now < special_tile_count; ++now) {
-                if (layer->data[i] == special_tile_cache[now].gid) {
-                    if (special_tile_cache[now].has_damage) {
-                        node->has_damage = 1;
-                        node->damage = special_tile_cache[now].damage;
-                    }
-                    if (special_tile_cache[now].has_collision) {
-                        SDL_Rect rect = special_tile_cache[now].collision;
-                        dstrect.x += rect.x;
-                        dstrect.y += rect.y;
-                        dstrect.w = rect.w;
-                        dstrect.h = rect.h;
-                    }
-                }
-            }
-            node->rect = dstrect;
-            node->next = map->collision_list->next;
-            map->collision_list->next = node;
+        int gid = layer->data[y * layer->width + x];
+        CollisionShape shape;
+        if (gid == 0 || !GetTileShape(map, gid, x, y, &shape)) {
+            continue;
+        }
+        TileProperty* prop = GetTileProperty(map, gid);
+        if (prop && prop->has_damage) {
+            AddCollisionShape(
+                map, &cell->hazard, cell->has_damage, &shape, x, y
+            );
+            cell->damage = cell->has_damage
+                               ? SDL_max(cell->damage, prop->damage)
+                               : prop->damage;
+            cell->has_damage = 1;
+        } else {
+            AddCollisionShape(map, &cell->solid, cell->is_solid, &shape, x, y);
+            cell->is_solid = 1;
+        }
+    }
+}
+
+void CreateCollisionGrid(Map* map) {
+    map->collision.width = map->tilemap->width;
+    map->collision.height = map->tilemap->height;
+    map->collision.cells = ArenaCalloc(
+        map->arena, map->collision.width * map->collision.height,
+        sizeof(CollisionCell)
+    );
+    for (int y = 0; y < map->collision.height; ++y) {
+        for (int x = 0; x < map->collision.width; ++x) {
+            UpdateCollisionCell(map, x, y);
         }
     }
 }
 
+CollisionCell* GetCollisionCell(Map* map, int x, int y) {
+    if (x < 0 || y < 0 || x >= map->collision.width ||
+        y >= map->collision.height) {
+        return NULL;
+    }
+    return &map->collision.cells[y * map->collision.width + x];
+}
+
+/*
+  Draw tiles of `group` inside `region` (in tiles, `NULL` for the whole map).
+*/
 #if defined(__PSP__)
-void DrawMap(Map* map, TilemapLayerGroup group)
+void DrawMap(Map* map, TilemapLayerGroup group, SDL_Rect* region)
 #else
-void DrawMapTotexture(Map* map, TilemapLayerGroup group)
+void DrawMapTotexture(Map* map, TilemapLayerGroup group, SDL_Rect* region)
 #endif
 {
+    SDL_Rect whole = {0, 0, map->tilemap->width, map->tilemap->height};
+    if (region == NULL) {
+        region = &whole;
+    }
     for (TilemapLayer* layer = map->tilemap->layers; layer;
          layer = layer->next) {
-        switch (group) {
-        case TILEMAP_LAYERGROUP_FRONT:
-            if (strncmp(layer->name.ptr, "front", 5) != 0) {
-                continue;
-                ;
-            }
-            break;
-        case TILEMAP_LAYERGROUP_MIDDLE:
-            if (strncmp(layer->name.ptr, "middle", 6) != 0) {
-                continue;
-            }
-            break;
-        case TILEMAP_LAYERGROUP_BACK:
-            if (strncmp(layer->name.ptr, "back", 4) != 0) {
-                continue;
-            }
-            break;
+        if (!IsLayerInGroup(layer, group)) {
+            continue;
         }
-        for (int i = 0; i < layer->data_count; ++i) {
-            if (layer->data[i] == 0) {
-                continue;
-            }
-            int x = i % layer->width;
-            int y = i / layer->width;
-            int flip;
-            SDL_Rect srcrect;
-            SDL_Rect dstrect = {
-                x * map->tilemap->tilewidth, y * map->tilemap->tileheight,
-                map->tilemap->tilewidth, map->tilemap->tileheight
-            };
+        for (int y = region->y; y < region->y + region->h; ++y) {
+            for (int x = region->x; x < region->x + region->w; ++x) {
+                int gid = layer->data[y * layer->width + x];
+                if (gid == 0) {
+                    continue;
+                }
+                int flip;
+                SDL_Rect srcrect;
+                SDL_Rect dstrect = {
+                    x * map->tilemap->tilewidth, y * map->tilemap->tileheight,
+                    map->tilemap->tilewidth, map->tilemap->tileheight
+                };
 #if defined(__PSP__)
-            dstrect.x += map->draw_offset.x;
-            dstrect.y += map->draw_offset.y;
-            dstrect.w *= map->draw_scale;
-            dstrect.h *= map->draw_scale;
-            if (!SDL_HasIntersection(&dstrect, &(SDL_Rect){0, 0, 480, 272})) {
-                continue;
-            }
+                Camera* camera = &map->camera;
+                dstrect.x = dstrect.x * camera->scale + camera->offset.x;
+                dstrect.y = dstrect.y * camera->scale + camera->offset.y;
+                dstrect.w *= camera->scale;
+                dstrect.h *= camera->scale;
 #endif
-            SDL_Texture* texture =
-                GetTextureRegionFromGID(map, layer->data[i], &flip, &srcrect);
-            SDL_RenderCopyEx(
-                game_app.renderer, texture, &srcrect, &dstrect, 0, NULL, flip
-            );
+                SDL_Texture* texture =
+                    GetTextureRegionFromGID(map, gid, &flip, &srcrect);
+#if defined(__PSP__)
+                // tiles share the tileset, so they are drawn together
+                SubmitTextureEx(
+                    texture, &srcrect,
+                    &(SDL_FRect){dstrect.x, dstrect.y, dstrect.w, dstrect.h},
+                    (SDL_Color){255, 255, 255, 255}, 0, NULL, flip
+                );
+#else
+                SDL_RenderCopyEx(
+                    game_app.renderer, texture, &srcrect, &dstrect, 0, NULL,
+                    flip
+                );
+#endif
+            }
+        }
+    }
+}
+
+#if defined(TH_THREADED_MAP_BAKE)
+/*
+  Composite rows [y0, y1) (in tiles) of `group` into its bake surface. Jobs
+  never share rows, so they can run at the same time.
+*/
+void CompositeMapRows(Map* map, TilemapLayerGroup group, int y0, int y1) {
+    SDL_Surface* dst = map->bake.surface[group];
+    for (TilemapLayer* layer = map->tilemap->layers; layer;
+         layer = layer->next) {
+        if (!IsLayerInGroup(layer, group)) {
+            continue;
+        }
+        for (int y = y0; y < y1; ++y) {
+            for (int x = 0; x < layer->width; ++x) {
+                int gid = layer->data[y * layer->width + x];
+                if (gid == 0) {
+                    continue;
+                }
+                int flip;
+                SDL_Rect srcrect;
+                SDL_Surface* src =
+                    GetSurfaceRegionFromGID(map, gid, &flip, &srcrect);
+                if (src) {
+                    BlendSurfaceRegion(
+                        src, &srcrect, dst, x * map->tilemap->tilewidth,
+                        y * map->tilemap->tileheight, flip
+                    );
+                }
+            }
+        }
+    }
+}
+
+int MapBakeWorker(void* data) {
+    Map* map = (Map*)data;
+    int job_count = 3 * map->bake.jobs_per_group;
+    for (int job = SDL_AtomicAdd(&map->bake.next_job, 1); job < job_count;
+         job = SDL_AtomicAdd(&map->bake.next_job, 1)) {
+        TilemapLayerGroup group = job / map->bake.jobs_per_group;
+        int y0 = job % map->bake.jobs_per_group * map->bake.rows_per_job;
+        int y1 = SDL_min(y0 + map->bake.rows_per_job, map->tilemap->height);
+        CompositeMapRows(map, group, y0, y1);
+        SDL_AtomicAdd(&map->bake.remaining_jobs[group], -1);
+    }
+    return 0;
+}
+
+/*
+  Split the three layer groups into bands of tile rows and composite them on
+  worker threads. The main thread returns immediately, and `DrawMapLayer`
+  uploads each group once all of its bands are finished.
+*/
+void StartMapBake(Map* map) {
+    map->bake.worker_count =
+        SDL_clamp(SDL_GetCPUCount() - 1, 1, MAX_BAKE_WORKERS);
+    // about four jobs per worker to balance the load
+    int jobs_per_group = SDL_max(map->bake.worker_count * 4 / 3, 1);
+    map->bake.rows_per_job =
+        SDL_max(map->tilemap->height / jobs_per_group, 1);
+    map->bake.jobs_per_group =
+        (map->tilemap->height + map->bake.rows_per_job - 1) /
+        map->bake.rows_per_job;
+    SDL_AtomicSet(&map->bake.next_job, 0);
+    for (int i = 0; i < 3; ++i) {
+        map->bake.surface[i] = SDL_CreateRGBSurfaceWithFormat(
+            0, map->tilemap->width * map->tilemap->tilewidth,
+            map->tilemap->height * map->tilemap->tileheight, 32,
+            SDL_PIXELFORMAT_ARGB8888
+        );
+        SDL_AtomicSet(&map->bake.remaining_jobs[i], map->bake.jobs_per_group);
+    }
+    for (int i = 0; i < map->bake.worker_count; ++i) {
+        map->bake.workers[i] = SDL_CreateThread(MapBakeWorker, "bake", map);
+    }
+    if (map->bake.workers[0] == NULL) {
+        // no thread available, do the work on this thread instead
+        MapBakeWorker(map);
+    }
+}
+
+SDL_Texture* GetMapLayerTexture(Map* map, TilemapLayerGroup group) {
+    switch (group) {
+    case TILEMAP_LAYERGROUP_FRONT:
+        return map->texture.front;
+    case TILEMAP_LAYERGROUP_MIDDLE:
+        return map->texture.middle;
+    case TILEMAP_LAYERGROUP_BACK:
+        return map->texture.back;
+    }
+    return NULL;
+}
+
+/*
+  Upload the surface of `group` if it is finished. Returns 0 if the group is
+  still being composited.
+*/
+int UploadBakedLayer(Map* map, TilemapLayerGroup group) {
+    if (map->bake.surface[group] == NULL) {
+        return 1;
+    }
+    if (SDL_AtomicGet(&map->bake.remaining_jobs[group]) > 0) {
+        return 0;
+    }
+    SDL_Surface* surface = map->bake.surface[group];
+    SDL_UpdateTexture(
+        GetMapLayerTexture(map, group), NULL, surface->pixels, surface->pitch
+    );
+    SDL_FreeSurface(surface);
+    map->bake.surface[group] = NULL;
+    return 1;
+}
+
+/*
+  Block until all worker threads are finished.
+*/
+void JoinMapBakeWorkers(Map* map) {
+    for (int i = 0; i < map->bake.worker_count; ++i) {
+        if (map->bake.workers[i]) {
+            SDL_WaitThread(map->bake.workers[i], NULL);
+            map->bake.workers[i] = NULL;
+        }
+    }
+    map->bake.worker_count = 0;
+}
+
+/*
+  Block until all worker threads are finished and every group is uploaded.
+*/
+void FinishMapBake(Map* map) {
+    JoinMapBakeWorkers(map);
+    for (int i = 0; i < 3; ++i) {
+        UploadBakedLayer(map, i);
+    }
+}
+
+/*
+  Stop baking a map which is about to be freed. The finished surfaces are
+  dropped instead of uploaded to textures that are destroyed next.
+*/
+void CancelMapBake(Map* map) {
+    JoinMapBakeWorkers(map);
+    for (int i = 0; i < 3; ++i) {
+        if (map->bake.surface[i]) {
+            SDL_FreeSurface(map->bake.surface[i]);
+            map->bake.surface[i] = NULL;
         }
     }
 }
+#endif
 
 Map* LoadMapFromMem(void* content, size_t size) {
-    Map* map = calloc(1, sizeof(Map));
-    map->entity_list = CreateEntityList();
-    map->tilemap = cute_tiled_load_map_from_memory(content, size, NULL);
-    map->draw_scale = 1;
-    map->draw_offset = (SDL_Point){0, 0};
-    CreateCollisionRectList(map);
+    // the parsed map is usually a bit larger than its JSON text
+    Arena* arena = CreateArena(2 * size + MAP_ARENA_MIN_BLOCK_SIZE);
+    if (!arena) {
+        return NULL;
+    }
+    Map* map = ArenaCalloc(arena, 1, sizeof(Map));
+    map->arena = arena;
+    map->tilemap = cute_tiled_load_map_from_memory(content, size, arena);
+    if (!map->tilemap) {
+        FreeArena(arena);
+        return NULL;
+    }
+    map->entities = CreateEntityStore();
+    map->particles = CreateParticlePool(arena, MAX_PARTICLES);
+    InitCamera(
+        &map->camera,
+        (SDL_Rect){0, 0, map->tilemap->width * map->tilemap->tilewidth,
+                   map->tilemap->height * map->tilemap->tileheight},
+        map->tilemap->tileheight
+    );
+    CreateTilePropertyList(map);
+    CreateCollisionGrid(map);
+    map->nav = CreateNavGraph(map);
     for (TilemapLayer* layer = map->tilemap->layers; layer;
          layer = layer->next) {
         if (strcmp(layer->type.ptr, "objectgroup") == 0) {
             for (TilemapObject* obj = layer->objects; obj; obj = obj->next) {
                 if (strcmp(obj->type.ptr, "EntityPosition") == 0 &&
                     strcmp(obj->name.ptr, "player_init") == 0) {
-                    Entity* player = CreatePlayerEntity(map, obj->x, obj->y);
-                    AddEntityToList(map->entity_list, player);
+                    map->entities->focus =
+                        CreatePlayerEntity(map, obj->x, obj->y);
                 }
             }
         }
     }
 #if !defined(__PSP__)
-    Uint32 format = 0;
-    SDL_QueryTexture(terrains_texture, &format, NULL, NULL, NULL);
+    if (!game_app.renderer) {
+        return map;
+    }
+    int map_w = map->tilemap->width * map->tilemap->tilewidth;
+    int map_h = map->tilemap->height * map->tilemap->tileheight;
+    #if defined(TH_THREADED_MAP_BAKE)
+    if (terrains_surface) {
+        map->texture.front = SDL_CreateTexture(
+            game_app.renderer, SDL_PIXELFORMAT_ARGB8888,
+            SDL_TEXTUREACCESS_TARGET, map_w, map_h
+        );
+        map->texture.middle = SDL_CreateTexture(
+            game_app.renderer, SDL_PIXELFORMAT_ARGB8888,
+            SDL_TEXTUREACCESS_TARGET, map_w, map_h
+        );
+        map->texture.back = SDL_CreateTexture(
+            game_app.renderer, SDL_PIXELFORMAT_ARGB8888,
+            SDL_TEXTUREACCESS_TARGET, map_w, map_h
+        );
+        SDL_SetTextureBlendMode(map->texture.front, SDL_BLENDMODE_BLEND);
+        SDL_SetTextureBlendMode(map->texture.middle, SDL_BLENDMODE_BLEND);
+        SDL_SetTextureBlendMode(map->texture.back, SDL_BLENDMODE_BLEND);
+        StartMapBake(map);
+        return map;
+    }
+    #endif
     map->texture.front = SDL_CreateTexture(
         game_app.renderer, 0,
-        SDL_TEXTUREACCESS_STATIC | SDL_TEXTUREACCESS_TARGET,
-        map->tilemap->width * map->tilemap->tilewidth,
-        map->tilemap->height * map->tilemap->tileheight
+        SDL_TEXTUREACCESS_STATIC | SDL_TEXTUREACCESS_TARGET, map_w, map_h
     );
     SDL_SetTextureBlendMode(map->texture.front, SDL_BLENDMODE_BLEND);
     map->texture.middle = SDL_CreateTexture(
         game_app.renderer, 0,
-        SDL_TEXTUREACCESS_STATIC | SDL_TEXTUREACCESS_TARGET,
-        map->tilemap->width * map->tilemap->tilewidth,
-        map->tilemap->height * map->tilemap->tileheight
+        SDL_TEXTUREACCESS_STATIC | SDL_TEXTUREACCESS_TARGET, map_w, map_h
     );
     SDL_SetTextureBlendMode(map->texture.middle, SDL_BLENDMODE_BLEND);
     map->texture.back = SDL_CreateTexture(
-        game_app.renderer, 0, SDL_TEXTUREACCESS_TARGET,
-        map->tilemap->width * map->tilemap->tilewidth,
-        map->tilemap->height * map->tilemap->tileheight
+        game_app.renderer, 0, SDL_TEXTUREACCESS_TARGET, map_w, map_h
     );
     SDL_SetTextureBlendMode(map->texture.back, SDL_BLENDMODE_BLEND);
 
     SDL_SetRenderTarget(game_app.renderer, map->texture.back);
-    DrawMapTotexture(map, TILEMAP_LAYERGROUP_BACK);
+    DrawMapTotexture(map, TILEMAP_LAYERGROUP_BACK, NULL);
     SDL_SetRenderTarget(game_app.renderer, NULL);
     SDL_SetRenderTarget(game_app.renderer, map->texture.middle);
-    DrawMapTotexture(map, TILEMAP_LAYERGROUP_MIDDLE);
+    DrawMapTotexture(map, TILEMAP_LAYERGROUP_MIDDLE, NULL);
     SDL_SetRenderTarget(game_app.renderer, NULL);
     SDL_SetRenderTarget(game_app.renderer, map->texture.front);
-    DrawMapTotexture(map, TILEMAP_LAYERGROUP_FRONT);
+    DrawMapTotexture(map, TILEMAP_LAYERGROUP_FRONT, NULL);
     SDL_SetRenderTarget(game_app.renderer, NULL);
 #endif
     return map;
@@ -267,78 +758,379 @@ Map* LoadMap(char* filename) {
 }
 
 void FreeMap(Map* map) {
-    cute_tiled_free_map(map->tilemap);
-    FreeEntityList(map->entity_list);
-    CollisionRectNode* next = NULL;
-    for (CollisionRectNode* node = map->collision_list->next; node;) {
-        next = node->next;
-        free(node);
-        node = next;
+#if defined(TH_THREADED_MAP_BAKE)
+    CancelMapBake(map);
+#endif
+    ForEachEntity(index, map->entities) {
+        FreeEntity(map->entities, index);
     }
+    FreeEntityStore(map->entities);
+    FreeNavGraph(map->nav);
 #if !defined(__PSP__)
     SDL_DestroyTexture(map->texture.front);
     SDL_DestroyTexture(map->texture.middle);
     SDL_DestroyTexture(map->texture.back);
 #endif
+    // the tilemap, collision grid, particles and map itself are in the arena
+    FreeArena(map->arena);
+}
+
+#if !defined(__PSP__)
+/*
+  Draw the dirty regions of a baked texture again. Only tiles inside them are
+  touched, so the cost is proportional to the change.
+*/
+void RebakeMapTexture(Map* map, SDL_Texture* texture, DirtyRegion* dirty) {
+    if (dirty->count == 0) {
+        return;
+    }
+    TilemapLayerGroup group = TILEMAP_LAYERGROUP_BACK;
+    if (texture == map->texture.front) {
+        group = TILEMAP_LAYERGROUP_FRONT;
+    } else if (texture == map->texture.middle) {
+        group = TILEMAP_LAYERGROUP_MIDDLE;
+    }
+    Uint8 r, g, b, a;
+    SDL_GetRenderDrawColor(game_app.renderer, &r, &g, &b, &a);
+    SDL_BlendMode blend_mode;
+    SDL_GetRenderDrawBlendMode(game_app.renderer, &blend_mode);
+    SDL_Texture* prev_target = SDL_GetRenderTarget(game_app.renderer);
+    SDL_SetRenderTarget(game_app.renderer, texture);
+    SDL_SetRenderDrawColor(game_app.renderer, 0, 0, 0, 0);
+    for (int i = 0; i < dirty->count; ++i) {
+        SDL_Rect* rect = &dirty->rects[i];
+        SDL_Rect clear_rect = {
+            rect->x * map->tilemap->tilewidth,
+            rect->y * map->tilemap->tileheight,
+            rect->w * map->tilemap->tilewidth,
+            rect->h * map->tilemap->tileheight
+        };
+        SDL_SetRenderDrawBlendMode(game_app.renderer, SDL_BLENDMODE_NONE);
+        SDL_RenderFillRect(game_app.renderer, &clear_rect);
+        SDL_SetRenderDrawBlendMode(game_app.renderer, SDL_BLENDMODE_BLEND);
+        DrawMapTotexture(map, group, rect);
+    }
+    SDL_SetRenderTarget(game_app.renderer, prev_target);
+    SDL_SetRenderDrawColor(game_app.renderer, r, g, b, a);
+    SDL_SetRenderDrawBlendMode(game_app.renderer, blend_mode);
+    dirty->count = 0;
 }
+#endif
 
+#if !defined(NDEBUG)
+void DrawCollisionShape(
+    Camera* camera, CollisionShape* shape, SDL_Color color
+) {
+    SDL_FRect rect = {
+        shape->rect.x * camera->scale + camera->offset.x,
+        shape->rect.y * camera->scale + camera->offset.y,
+        shape->rect.w * camera->scale, shape->rect.h * camera->scale
+    };
+    SubmitFillRect(&rect, color);
+    SubmitDrawRect(&rect, (SDL_Color){0, 0, 0, 255});
+}
+#endif
+
+RenderLayer map_render_layer[] = {
+    [TILEMAP_LAYERGROUP_FRONT] = RENDER_LAYER_MAP_FRONT,
+    [TILEMAP_LAYERGROUP_MIDDLE] = RENDER_LAYER_MAP_MIDDLE,
+    [TILEMAP_LAYERGROUP_BACK] = RENDER_LAYER_MAP_BACK
+};
+
+/*
+  Point the camera at the entity it follows. Call it once per frame, after
+  `InterpolateEntityStore`.
+*/
+void UpdateMapCamera(Map* map) {
+    int index = GetEntityIndex(map->entities, map->entities->focus);
+    if (index >= 0) {
+        FollowCamera(&map->camera, GetEntityDrawPos(map->entities, index));
+    }
+}
+
+int CompareEntityIndices(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+/*
+  Draw `group` and, with the middle group, what stands on it. Only what the
+  camera can see is submitted.
+*/
 void DrawMapLayer(Map* map, TilemapLayerGroup group) {
+    Camera* camera = &map->camera;
+    PushRenderLayer(map_render_layer[group], RENDER_ORDER_SUBMITTED);
 #if defined(__PSP__)
-    DrawMap(map, group);
+    SDL_Rect tiles = GetVisibleTiles(
+        camera, map->tilemap->tilewidth, map->tilemap->tileheight
+    );
+    DrawMap(map, group, &tiles);
 #else
     SDL_Texture* texture = NULL;
     switch (group) {
     case TILEMAP_LAYERGROUP_BACK:
         texture = map->texture.back;
+        RebakeMapTexture(map, texture, &map->dirty.back);
         break;
     case TILEMAP_LAYERGROUP_MIDDLE:
         texture = map->texture.middle;
+        RebakeMapTexture(map, texture, &map->dirty.middle);
         break;
     case TILEMAP_LAYERGROUP_FRONT:
         texture = map->texture.front;
+        RebakeMapTexture(map, texture, &map->dirty.front);
         break;
     }
-    int w, h;
-    SDL_QueryTexture(texture, NULL, NULL, &w, &h);
-    SDL_RenderCopy(
-        game_app.renderer, texture, NULL,
-        &(SDL_Rect){map->draw_offset.x, map->draw_offset.y, w * map->draw_scale,
-                    h * map->draw_scale}
-    );
+    #if defined(TH_THREADED_MAP_BAKE)
+    if (!UploadBakedLayer(map, group)) {
+        // not composited yet, keep presenting frames without it
+        texture = NULL;
+    }
+    #endif
+    SDL_Rect src;
+    if (texture &&
+        SDL_IntersectRect(&camera->viewport, &camera->bounds, &src)) {
+        // only the visible part of the baked texture is copied
+        SubmitTexture(
+            texture, &src,
+            &(SDL_FRect){src.x * camera->scale + camera->offset.x,
+                         src.y * camera->scale + camera->offset.y,
+                         src.w * camera->scale, src.h * camera->scale},
+            (SDL_Color){255, 255, 255, 255}
+        );
+    }
 #endif
+    PopRenderLayer();
     if (group == TILEMAP_LAYERGROUP_MIDDLE) {
-        ForEachEntity(entity, map->entity_list) {
-            DrawEntity(entity->data);
+        SDL_FRect visible = GetVisibleRect(camera);
+        int count;
+        int* indices = QueryEntitiesInRect(map->entities, &visible, &count);
+        // the grid returns entities by cell, which changes as they move, so
+        // draw them in the order of the store like before culling
+        SDL_qsort(indices, count, sizeof(int), CompareEntityIndices);
+        // entities overlap, so grouping them by texture could put one in
+        // front of another from frame to frame
+        PushRenderLayer(RENDER_LAYER_ENTITIES, RENDER_ORDER_SUBMITTED);
+        for (int i = 0; i < count; ++i) {
+            DrawEntity(map->entities, indices[i]);
         }
+        PopRenderLayer();
+        DrawParticles(map->particles, camera, map->entities->alpha);
 #if !defined(NDEBUG)
-        for (CollisionRectNode* node = map->collision_list->next; node;
-             node = node->next) {
-            if (node->has_damage) {
-                SDL_SetRenderDrawColor(game_app.renderer, 255, 0, 0, 48);
-            } else {
-                SDL_SetRenderDrawColor(game_app.renderer, 0, 255, 0, 48);
+        SDL_Rect tiles = GetVisibleTiles(
+            camera, map->tilemap->tilewidth, map->tilemap->tileheight
+        );
+        PushRenderLayer(RENDER_LAYER_DEBUG, RENDER_ORDER_SUBMITTED);
+        for (int y = tiles.y; y < tiles.y + tiles.h; ++y) {
+            for (int x = tiles.x; x < tiles.x + tiles.w; ++x) {
+                CollisionCell* cell =
+                    &map->collision.cells[y * map->collision.width + x];
+                if (cell->is_solid) {
+                    DrawCollisionShape(
+                        camera, &cell->solid, (SDL_Color){0, 255, 0, 48}
+                    );
+                }
+                if (cell->has_damage) {
+                    DrawCollisionShape(
+                        camera, &cell->hazard, (SDL_Color){255, 0, 0, 48}
+                    );
+                }
             }
-            SDL_Rect rect = {
-                node->rect.x * map->draw_scale + map->draw_offset.x,
-                node->rect.y * map->draw_scale + map->draw_offset.y,
-                node->rect.w * map->draw_scale, node->rect.h * map->draw_scale
-            };
-            SDL_RenderFillRect(game_app.renderer, &rect);
-            SDL_SetRenderDrawColor(game_app.renderer, 0, 0, 0, 255);
-            SDL_RenderDrawRect(game_app.renderer, &rect);
         }
+        PopRenderLayer();
 #endif
     }
 }
 
-int MapIsEmptyEx(Map* map, SDL_FRect* rect, SDL_FRect* union_rect) {
-    for (CollisionRectNode* node = map->collision_list->next; node;
-         node = node->next) {
-        SDL_FRect now = {
-            node->rect.x, node->rect.y, node->rect.w, node->rect.h
+TilemapLayer* GetMapLayer(Map* map, char* name) {
+    for (TilemapLayer* layer = map->tilemap->layers; layer;
+         layer = layer->next) {
+        if (strcmp(layer->name.ptr, name) == 0 &&
+            strcmp(layer->type.ptr, "tilelayer") == 0) {
+            return layer;
+        }
+    }
+    return NULL;
+}
+
+int GetMapTile(Map* map, char* layer_name, int x, int y) {
+    TilemapLayer* layer = GetMapLayer(map, layer_name);
+    if (!layer || x < 0 || y < 0 || x >= layer->width || y >= layer->height) {
+        return 0;
+    }
+    return layer->data[y * layer->width + x];
+}
+
+#if !defined(__PSP__)
+/*
+  Add the tile at (x, y) to `dirty`. It joins the rectangle which grows by the
+  fewest clean tiles, unless more than `DIRTY_RECT_MAX_WASTE` clean tiles would
+  be drawn again and there is room for a rectangle of its own.
+*/
+void AddDirtyTile(DirtyRegion* dirty, int x, int y) {
+    SDL_Rect tile = {x, y, 1, 1};
+    int best = -1, best_waste = 0;
+    SDL_Rect best_union;
+    for (int i = 0; i < dirty->count; ++i) {
+        SDL_Rect* rect = &dirty->rects[i];
+        SDL_Rect joined;
+        SDL_UnionRect(rect, &tile, &joined);
+        int waste = joined.w * joined.h - rect->w * rect->h - 1;
+        if (best < 0 || waste < best_waste) {
+            best = i;
+            best_waste = waste;
+            best_union = joined;
+        }
+    }
+    if (best >= 0 && (best_waste <= DIRTY_RECT_MAX_WASTE ||
+                      dirty->count == MAX_DIRTY_RECTS)) {
+        dirty->rects[best] = best_union;
+    } else {
+        dirty->rects[dirty->count++] = tile;
+    }
+}
+#endif
+
+/*
+  Change the tile at (x, y) of layer `layer_name` to `gid` (0 to remove it).
+
+  Only the collision cell at (x, y) is updated. The tile is marked dirty in the
+  baked texture and will be drawn again next time `DrawMapLayer` is called.
+
+  Returns 0 if the layer does not exist or (x, y) is out of the map.
+*/
+int SetMapTile(Map* map, char* layer_name, int x, int y, int gid) {
+    TilemapLayer* layer = GetMapLayer(map, layer_name);
+    if (!layer || x < 0 || y < 0 || x >= layer->width || y >= layer->height) {
+        return 0;
+    }
+    if (layer->data[y * layer->width + x] == gid) {
+        return 1;
+    }
+#if defined(TH_THREADED_MAP_BAKE)
+    // workers are still reading tiles
+    FinishMapBake(map);
+#endif
+    layer->data[y * layer->width + x] = gid;
+    if (IsLayerInGroup(layer, TILEMAP_LAYERGROUP_MIDDLE)) {
+        UpdateCollisionCell(map, x, y);
+        MarkNavGraphDirty(map->nav, x, y);
+        // the entities standing on the tile may fall now
+        SDL_FRect tile = {
+            x * map->tilemap->tilewidth, y * map->tilemap->tileheight,
+            map->tilemap->tilewidth, map->tilemap->tileheight
         };
-        if (SDL_HasIntersectionF(rect, &now) && !node->has_damage) {
+        WakeEntitiesInRect(map->entities, &tile);
+    }
+#if !defined(__PSP__)
+    DirtyRegion* dirty = NULL;
+    if (IsLayerInGroup(layer, TILEMAP_LAYERGROUP_FRONT)) {
+        dirty = &map->dirty.front;
+    } else if (IsLayerInGroup(layer, TILEMAP_LAYERGROUP_MIDDLE)) {
+        dirty = &map->dirty.middle;
+    } else if (IsLayerInGroup(layer, TILEMAP_LAYERGROUP_BACK)) {
+        dirty = &map->dirty.back;
+    }
+    if (dirty) {
+        AddDirtyTile(dirty, x, y);
+    }
+#endif
+    return 1;
+}
+
+/*
+  Find the range of collision cells which `rect` may overlap.
+*/
+void GetCollisionCellRange(
+    Map* map, SDL_FRect* rect, int* x0, int* y0, int* x1, int* y1
+) {
+    *x0 = SDL_max((int)SDL_floorf(rect->x / map->tilemap->tilewidth), 0);
+    *y0 = SDL_max((int)SDL_floorf(rect->y / map->tilemap->tileheight), 0);
+    *x1 = SDL_min(
+        (int)SDL_floorf((rect->x + rect->w) / map->tilemap->tilewidth),
+        map->collision.width - 1
+    );
+    *y1 = SDL_min(
+        (int)SDL_floorf((rect->y + rect->h) / map->tilemap->tileheight),
+        map->collision.height - 1
+    );
+}
+
+/*
+  Test whether `rect` overlaps `shape`. For a masked tile, every row of the
+  tile is tested against the pixel span of `rect` with one 64-bit AND per
+  word.
+*/
+int CollisionShapeOverlaps(Map* map, CollisionShape* shape, SDL_FRect* rect) {
+    SDL_FRect now = {
+        shape->rect.x, shape->rect.y, shape->rect.w, shape->rect.h
+    };
+    if (!SDL_HasIntersectionF(rect, &now)) {
+        return 0;
+    }
+    if (!shape->mask) {
+        return 1;
+    }
+    int tile_w = terrains_mask->tile_width;
+    int tile_h = terrains_mask->tile_height;
+    int words_per_row = terrains_mask->words_per_row;
+    // tile origin in world coordinates
+    float ox = SDL_floorf(shape->rect.x / (float)tile_w) * tile_w;
+    float oy = SDL_floorf(shape->rect.y / (float)tile_h) * tile_h;
+    int x0 = SDL_max((int)SDL_floorf(rect->x - ox), 0);
+    int x1 = SDL_min((int)SDL_ceilf(rect->x + rect->w - ox), tile_w);
+    int y0 = SDL_max((int)SDL_floorf(rect->y - oy), 0);
+    int y1 = SDL_min((int)SDL_ceilf(rect->y + rect->h - oy), tile_h);
+    if (x0 >= x1 || y0 >= y1) {
+        return 0;
+    }
+    // find the span in the unflipped mask
+    if (shape->mask_flip & SDL_FLIP_HORIZONTAL) {
+        int temp = x0;
+        x0 = tile_w - x1;
+        x1 = tile_w - temp;
+    }
+    if (shape->mask_flip & SDL_FLIP_VERTICAL) {
+        int temp = y0;
+        y0 = tile_h - y1;
+        y1 = tile_h - temp;
+    }
+    if (shape->mask_flip & TILE_FLIP_DIAGONAL) {
+        int temp_0 = x0, temp_1 = x1;
+        x0 = y0;
+        x1 = y1;
+        y0 = temp_0;
+        y1 = temp_1;
+    }
+    for (int w = x0 / 64; w <= (x1 - 1) / 64; ++w) {
+        // bits of the span [x0, x1) which fall into word `w`
+        int lo = SDL_max(x0 - w * 64, 0);
+        int hi = SDL_min(x1 - w * 64, 64);
+        uint64_t span = (hi - lo == 64 ? ~(uint64_t)0
+                                       : (((uint64_t)1 << (hi - lo)) - 1))
+                        << lo;
+        for (int y = y0; y < y1; ++y) {
+            if (shape->mask[y * words_per_row + w] & span) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+int MapIsEmptyEx(Map* map, SDL_FRect* rect, SDL_FRect* union_rect) {
+    int x0, y0, x1, y1;
+    GetCollisionCellRange(map, rect, &x0, &y0, &x1, &y1);
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            CollisionCell* cell =
+                &map->collision.cells[y * map->collision.width + x];
+            if (!cell->is_solid ||
+                !CollisionShapeOverlaps(map, &cell->solid, rect)) {
+                continue;
+            }
             if (union_rect) {
+                SDL_Rect* solid = &cell->solid.rect;
+                SDL_FRect now = {solid->x, solid->y, solid->w, solid->h};
                 SDL_UnionFRect(rect, &now, union_rect);
             }
             return 0;
@@ -352,14 +1144,267 @@ int MapIsEmpty(Map* map, SDL_FRect* rect) {
 }
 
 int MapHasDamage(Map* map, SDL_FRect* rect) {
-    for (CollisionRectNode* node = map->collision_list->next; node;
-         node = node->next) {
-        SDL_FRect now = {
-            node->rect.x, node->rect.y, node->rect.w, node->rect.h
-        };
-        if (SDL_HasIntersectionF(rect, &now) && node->has_damage) {
-            return node->damage;
+    int x0, y0, x1, y1;
+    GetCollisionCellRange(map, rect, &x0, &y0, &x1, &y1);
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            CollisionCell* cell =
+                &map->collision.cells[y * map->collision.width + x];
+            if (cell->has_damage &&
+                CollisionShapeOverlaps(map, &cell->hazard, rect)) {
+                return cell->damage;
+            }
         }
     }
     return 0;
 }
+
+/*
+  Intersect the ray with the axis-aligned box `[min, max]`. `axis` is set to
+  the axis of the entering face (0 for x, 1 for y), or -1 if the ray starts
+  inside the box.
+*/
+int RayIntersectBox(
+    Vector2f* origin, Vector2f* inv_dir, float min_x, float min_y, float max_x,
+    float max_y, float* t_near, float* t_far, int* axis
+) {
+    float x_near = -FLT_MAX, x_far = FLT_MAX;
+    float y_near = -FLT_MAX, y_far = FLT_MAX;
+    // `inv_dir` is `FLT_MAX` on a zero component, the ray is then parallel to
+    // the slab and either always or never inside it
+    if (inv_dir->x != FLT_MAX) {
+        float tx0 = (min_x - origin->x) * inv_dir->x;
+        float tx1 = (max_x - origin->x) * inv_dir->x;
+        x_near = SDL_min(tx0, tx1);
+        x_far = SDL_max(tx0, tx1);
+    } else if (origin->x < min_x || origin->x > max_x) {
+        return 0;
+    }
+    if (inv_dir->y != FLT_MAX) {
+        float ty0 = (min_y - origin->y) * inv_dir->y;
+        float ty1 = (max_y - origin->y) * inv_dir->y;
+        y_near = SDL_min(ty0, ty1);
+        y_far = SDL_max(ty0, ty1);
+    } else if (origin->y < min_y || origin->y > max_y) {
+        return 0;
+    }
+    *axis = x_near > y_near ? 0 : 1;
+    *t_near = SDL_max(x_near, y_near);
+    *t_far = SDL_min(x_far, y_far);
+    if (*t_near <= 0.0f) {
+        *axis = -1;
+    }
+    return *t_near <= *t_far && *t_far >= 0.0f;
+}
+
+/*
+  Walk the pixels of a masked tile between `t0` and `t1` with a second DDA.
+  `axis` is the axis of the face the ray entered through.
+*/
+int RaycastTileMask(
+    Map* map, CollisionShape* shape, int tile_x, int tile_y, Vector2f* origin,
+    Vector2f* dir, Vector2f* inv_dir, float t0, float t1, int axis,
+    RaycastHit* hit
+) {
+    int tile_w = map->tilemap->tilewidth;
+    int tile_h = map->tilemap->tileheight;
+    float ox = tile_x * tile_w, oy = tile_y * tile_h;
+    float px = origin->x + dir->x * t0 - ox;
+    float py = origin->y + dir->y * t0 - oy;
+    int x = SDL_clamp((int)SDL_floorf(px), 0, tile_w - 1);
+    int y = SDL_clamp((int)SDL_floorf(py), 0, tile_h - 1);
+    // nudge the start onto the pixel the ray is entering through the face
+    if (axis == 0 && dir->x < 0.0f && px == SDL_floorf(px)) {
+        x = SDL_max(x - 1, 0);
+    }
+    if (axis == 1 && dir->y < 0.0f && py == SDL_floorf(py)) {
+        y = SDL_max(y - 1, 0);
+    }
+    int step_x = dir->x > 0.0f ? 1 : -1;
+    int step_y = dir->y > 0.0f ? 1 : -1;
+    float delta_x = SDL_fabsf(inv_dir->x);
+    float delta_y = SDL_fabsf(inv_dir->y);
+    float next_x = dir->x == 0.0f
+                       ? FLT_MAX
+                       : (ox + x + (step_x > 0) - origin->x) * inv_dir->x;
+    float next_y = dir->y == 0.0f
+                       ? FLT_MAX
+                       : (oy + y + (step_y > 0) - origin->y) * inv_dir->y;
+    float t = t0;
+    while (t <= t1) {
+        if (TileMaskIsSolid(shape, x, y)) {
+            hit->distance = t;
+            hit->normal = (Vector2f){0.0f, 0.0f};
+            if (axis == 0) {
+                hit->normal.x = (float)-step_x;
+            } else if (axis == 1) {
+                hit->normal.y = (float)-step_y;
+            }
+            return 1;
+        }
+        if (next_x < next_y) {
+            t = next_x;
+            next_x += delta_x;
+            x += step_x;
+            axis = 0;
+        } else {
+            t = next_y;
+            next_y += delta_y;
+            y += step_y;
+            axis = 1;
+        }
+        if (x < 0 || x >= tile_w || y < 0 || y >= tile_h) {
+            break;
+        }
+    }
+    return 0;
+}
+
+/*
+  Cast one ray. `dir` must be normalized and `inv_dir` is its reciprocal.
+*/
+int CastRay(
+    Map* map, Vector2f origin, Vector2f dir, Vector2f inv_dir,
+    float max_distance, RaycastHit* hit
+) {
+    int tile_w = map->tilemap->tilewidth;
+    int tile_h = map->tilemap->tileheight;
+    hit->is_hit = 0;
+    // clip the ray to the map first, so the walk never leaves the grid
+    float t_start, t_end;
+    int axis;
+    if (!RayIntersectBox(
+            &origin, &inv_dir, 0.0f, 0.0f, (float)map->collision.width * tile_w,
+            (float)map->collision.height * tile_h, &t_start, &t_end, &axis
+        )) {
+        return 0;
+    }
+    t_start = SDL_max(t_start, 0.0f);
+    t_end = SDL_min(t_end, max_distance);
+    float sx = origin.x + dir.x * t_start, sy = origin.y + dir.y * t_start;
+    int x = SDL_clamp(
+        (int)SDL_floorf(sx / tile_w), 0, map->collision.width - 1
+    );
+    int y = SDL_clamp(
+        (int)SDL_floorf(sy / tile_h), 0, map->collision.height - 1
+    );
+    int step_x = dir.x > 0.0f ? 1 : -1;
+    int step_y = dir.y > 0.0f ? 1 : -1;
+    float delta_x = SDL_fabsf(tile_w * inv_dir.x);
+    float delta_y = SDL_fabsf(tile_h * inv_dir.y);
+    float next_x = dir.x == 0.0f
+                       ? FLT_MAX
+                       : ((x + (step_x > 0)) * tile_w - origin.x) * inv_dir.x;
+    float next_y = dir.y == 0.0f
+                       ? FLT_MAX
+                       : ((y + (step_y > 0)) * tile_h - origin.y) * inv_dir.y;
+    float t = t_start;
+    while (t <= t_end) {
+        CollisionCell* cell =
+            &map->collision.cells[y * map->collision.width + x];
+        float t_cell_end = SDL_min(SDL_min(next_x, next_y), t_end);
+        float t_near, t_far;
+        SDL_Rect* solid = &cell->solid.rect;
+        if (cell->is_solid &&
+            RayIntersectBox(
+                &origin, &inv_dir, solid->x, solid->y, solid->x + solid->w,
+                solid->y + solid->h, &t_near, &t_far, &axis
+            ) &&
+            t_near <= t_cell_end) {
+            t_near = SDL_max(t_near, t);
+            t_far = SDL_min(t_far, t_cell_end);
+            int is_hit = 0;
+            if (cell->solid.mask) {
+                is_hit = RaycastTileMask(
+                    map, &cell->solid, x, y, &origin, &dir, &inv_dir, t_near,
+                    t_far, axis, hit
+                );
+            } else {
+                hit->distance = t_near;
+                hit->normal = (Vector2f){0.0f, 0.0f};
+                if (axis == 0) {
+                    hit->normal.x = (float)-step_x;
+                } else if (axis == 1) {
+                    hit->normal.y = (float)-step_y;
+                }
+                is_hit = 1;
+            }
+            if (is_hit) {
+                hit->is_hit = 1;
+                hit->point = (Vector2f){
+                    origin.x + dir.x * hit->distance,
+                    origin.y + dir.y * hit->distance
+                };
+                hit->tile = (Vector2){x, y};
+                return 1;
+            }
+        }
+        if (next_x < next_y) {
+            t = next_x;
+            next_x += delta_x;
+            x += step_x;
+        } else {
+            t = next_y;
+            next_y += delta_y;
+            y += step_y;
+        }
+        if (x < 0 || x >= map->collision.width || y < 0 ||
+            y >= map->collision.height) {
+            break;
+        }
+    }
+    return 0;
+}
+
+/*
+  Cast a ray from `origin` along `direction` (which need not be normalized)
+  for at most `max_distance` pixels. The tile grid is walked with a DDA and
+  only the tiles the ray passes through are tested against their collision
+  shapes. Damaging tiles do not block rays, the same as `MapIsEmpty`.
+
+  Return 1 and fill `hit` if something was hit.
+*/
+int MapRaycast(
+    Map* map, Vector2f origin, Vector2f direction, float max_distance,
+    RaycastHit* hit
+) {
+    return MapRaycastBatch(map, 1, &origin, &direction, max_distance, hit);
+}
+
+/*
+  Cast `count` rays at once and fill `hits[i]` for each of them. Return the
+  number of rays that hit something.
+*/
+int MapRaycastBatch(
+    Map* map, int count, Vector2f* origins, Vector2f* directions,
+    float max_distance, RaycastHit* hits
+) {
+    int hit_count = 0;
+    for (int i = 0; i < count; ++i) {
+        hits[i].is_hit = 0;
+        float length = SDL_sqrtf(
+            directions[i].x * directions[i].x +
+            directions[i].y * directions[i].y
+        );
+        if (length == 0.0f) {
+            continue;
+        }
+        Vector2f dir = {directions[i].x / length, directions[i].y / length};
+        // a zero component is marked with `FLT_MAX`, see `RayIntersectBox`
+        Vector2f inv_dir = {
+            dir.x == 0.0f ? FLT_MAX : 1.0f / dir.x,
+            dir.y == 0.0f ? FLT_MAX : 1.0f / dir.y
+        };
+        hit_count +=
+            CastRay(map, origins[i], dir, inv_dir, max_distance, &hits[i]);
+    }
+    return hit_count;
+}
+
+int MapHasLineOfSight(Map* map, Vector2f from, Vector2f to) {
+    Vector2f direction = {to.x - from.x, to.y - from.y};
+    float distance =
+        SDL_sqrtf(direction.x * direction.x + direction.y * direction.y);
+    RaycastHit hit;
+    return !MapRaycast(map, from, direction, distance, &hit);
+}
@@ -23,9 +23,14 @@
 #ifndef TH_MAP_H_
 #define TH_MAP_H_
 
+#include "arena.h"
+#include "camera.h"
 #include "entities/base.h"
+#include "navigation.h"
+#include "particles.h"
 #include <SDL.h>
 #include <cute_tiled.h>
+#include <stdint.h>
 
 typedef cute_tiled_map_t Tilemap;
 typedef cute_tiled_layer_t TilemapLayer;
@@ -35,33 +40,141 @@ typedef cute_tiled_tile_descriptor_t TileDescriptor;
 typedef cute_tiled_frame_t TileFrame;
 typedef cute_tiled_tileset_t Tileset;
 
+#define MAX_BAKE_WORKERS 8
+#define MAX_DIRTY_RECTS 8
+
 typedef enum TilemapLayerGroup {
     TILEMAP_LAYERGROUP_FRONT,
     TILEMAP_LAYERGROUP_MIDDLE,
     TILEMAP_LAYERGROUP_BACK
 } TilemapLayerGroup;
 
-typedef struct CollisionRectNode {
+// please note this alignment, it should have the same value as `_pack_` in
+// `tools/respack.py`
+#pragma pack(8)
+
+typedef struct TileMaskHeader {
+    char magic[4];
+    uint8_t version;
+    uint16_t tile_width;
+    uint16_t tile_height;
+    uint16_t tile_count;
+    uint16_t words_per_row;
+} TileMaskHeader;
+
+#pragma pack()
+
+/*
+  1-bit-per-pixel collision masks of all tiles in a tileset, generated by
+  `tools/respack.py`. Bit `i` of word `w` in a row is pixel `64 * w + i`.
+*/
+typedef struct TileMask {
+    int tile_width;
+    int tile_height;
+    int tile_count;
+    int words_per_row;
+    uint64_t* bits;
+    // bounding box of the solid pixels of each tile
+    SDL_Rect* bounds;
+} TileMask;
+
+typedef struct TileProperty {
+    int gid;
+    int has_damage;
+    int damage;
+    int has_collision;
+    SDL_Rect collision;
+} TileProperty;
+
+// set in `CollisionShape.mask_flip` beside `SDL_RendererFlip` flags
+#define TILE_FLIP_DIAGONAL 0x4
+
+typedef struct CollisionShape {
     SDL_Rect rect;
+    // pixel mask of the tile, `NULL` if `rect` is the exact shape
+    uint64_t* mask;
+    int mask_flip;
+    // mask of several tiles drawn over each other, kept to be reused when the
+    // cell is updated again
+    uint64_t* merged;
+} CollisionShape;
+
+/*
+  One cell of the collision grid, which has the same size as the map. The
+  tiles of all middle layers at a cell are combined: `solid` is the shape that
+  blocks movement and `hazard` is the shape that hurts. A shape is only valid
+  if its flag (`is_solid` or `has_damage`) is set.
+*/
+typedef struct CollisionCell {
+    int is_solid;
     int has_damage;
     int damage;
-    struct CollisionRectNode* next;
-} CollisionRectNode;
+    CollisionShape solid;
+    CollisionShape hazard;
+} CollisionCell;
 
-typedef CollisionRectNode* CollisionRectList;
+typedef struct RaycastHit {
+    int is_hit;
+    // distance from the origin of the ray to `point`
+    float distance;
+    Vector2f point;
+    // zero if the ray starts inside a solid tile
+    Vector2f normal;
+    // coordinate of the tile which was hit
+    Vector2 tile;
+} RaycastHit;
+
+/*
+  Regions of a baked texture (in tiles) that should be drawn again. Edits far
+  apart are kept in separate rectangles, so that drawing them again does not
+  touch every tile in between.
+*/
+typedef struct DirtyRegion {
+    int count;
+    SDL_Rect rects[MAX_DIRTY_RECTS];
+} DirtyRegion;
 
 typedef struct Map {
+    // all map-lifetime data, including the map itself, lives in the arena
+    Arena* arena;
     Tilemap* tilemap;
-    int draw_scale;
-    Vector2 draw_offset;
-    CollisionRectList collision_list;
-    EntityList entity_list;
+    Camera camera;
+    struct {
+        int count;
+        TileProperty* data;
+    } tile_properties;
+    struct {
+        int width;
+        int height;
+        CollisionCell* cells;
+    } collision;
+    NavGraph* nav;
+    EntityStore* entities;
+    ParticlePool* particles;
 #if !defined(__PSP__)
     struct {
         SDL_Texture* front;
         SDL_Texture* middle;
         SDL_Texture* back;
     } texture;
+    struct {
+        DirtyRegion front;
+        DirtyRegion middle;
+        DirtyRegion back;
+    } dirty;
+    #if defined(TH_THREADED_MAP_BAKE)
+    // layer groups are composited into surfaces on worker threads, indexed by
+    // `TilemapLayerGroup`
+    struct {
+        int worker_count;
+        SDL_Thread* workers[MAX_BAKE_WORKERS];
+        int rows_per_job;
+        int jobs_per_group;
+        SDL_atomic_t next_job;
+        SDL_atomic_t remaining_jobs[3];
+        SDL_Surface* surface[3];
+    } bake;
+    #endif
 #endif
 } Map;
 
@@ -70,9 +183,24 @@ void QuitMapSystem();
 Map* LoadMapFromMem(void* content, size_t size);
 Map* LoadMap(char* filename);
 void FreeMap(Map* map);
+void UpdateMapCamera(Map* map);
 void DrawMapLayer(Map* map, TilemapLayerGroup group);
+TilemapLayer* GetMapLayer(Map* map, char* name);
+int GetMapTile(Map* map, char* layer_name, int x, int y);
+int SetMapTile(Map* map, char* layer_name, int x, int y, int gid);
+CollisionCell* GetCollisionCell(Map* map, int x, int y);
+int CollisionShapeOverlaps(Map* map, CollisionShape* shape, SDL_FRect* rect);
 int MapIsEmptyEx(Map* map, SDL_FRect* rect, SDL_FRect* union_rect);
 int MapIsEmpty(Map* map, SDL_FRect* rect);
 int MapHasDamage(Map* map, SDL_FRect* rect);
+int MapRaycast(
+    Map* map, Vector2f origin, Vector2f direction, float max_distance,
+    RaycastHit* hit
+);
+int MapRaycastBatch(
+    Map* map, int count, Vector2f* origins, Vector2f* directions,
+    float max_distance, RaycastHit* hits
+);
+int MapHasLineOfSight(Map* map, Vector2f from, Vector2f to);
 
 #endif
@@ -0,0 +1,555 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "navigation.h"
+#include "entities/base.h"
+#include "entities/player.h"
+#include "map.h"
+#include <stdlib.h>
+#include <string.h>
+
+// extra cost (in tiles) of leaving the ground, so that walking is preferred
+#define NAV_FALL_PENALTY 0.5f
+#define NAV_JUMP_PENALTY 1.0f
+
+int IsNavCellEmpty(Map* map, int x, int y) {
+    CollisionCell* cell = GetCollisionCell(map, x, y);
+    return cell && !cell->is_solid && !cell->has_damage;
+}
+
+int IsNavCellGround(Map* map, int x, int y) {
+    CollisionCell* cell = GetCollisionCell(map, x, y);
+    return cell && cell->is_solid && !cell->has_damage;
+}
+
+void AddNavEdge(
+    NavGraph* graph, int* capacity, NavEdgeType type, int from, int to,
+    int from_x, int to_x, float cost
+) {
+    if (graph->edge_count == *capacity) {
+        *capacity = *capacity ? 2 * *capacity : 64;
+        graph->edges = realloc(graph->edges, *capacity * sizeof(NavEdge));
+    }
+    graph->edges[graph->edge_count++] = (NavEdge){
+        type, from, to, from_x, to_x, cost
+    };
+}
+
+/*
+  Time (in seconds) at which a jump lands `dy` pixels below its takeoff, or a
+  negative number if the jump cannot get that high.
+*/
+float GetJumpLandingTime(float dy) {
+    float v = PLAYER_JUMP_VELOCITY;
+    float d = v * v + 2.0f * GRAVITY_Y * dy;
+    if (d < 0.0f) {
+        return -1.0f;
+    }
+    return (-v + SDL_sqrtf(d)) / GRAVITY_Y;
+}
+
+/*
+  Test a jump from tile `from` to tile `to`. The arc is approximated by two
+  segments through its apex, which are checked with `MapHasLineOfSight`.
+*/
+int CanJump(Map* map, int from_x, int from_y, int to_x, int to_y) {
+    int tile_w = map->tilemap->tilewidth;
+    int tile_h = map->tilemap->tileheight;
+    float dx = (float)(SDL_abs(to_x - from_x) - 1) * tile_w;
+    float t = GetJumpLandingTime((float)(to_y - from_y) * tile_h);
+    if (t < 0.0f || SDL_max(dx, 0.0f) > PLAYER_RUN_VELOCITY * t) {
+        return 0;
+    }
+    float apex_t = -PLAYER_JUMP_VELOCITY / (float)GRAVITY_Y;
+    float apex_h = PLAYER_JUMP_VELOCITY * PLAYER_JUMP_VELOCITY /
+                   (2.0f * GRAVITY_Y);
+    Vector2f takeoff = {(from_x + 0.5f) * tile_w, (from_y + 0.5f) * tile_h};
+    Vector2f landing = {(to_x + 0.5f) * tile_w, (to_y + 0.5f) * tile_h};
+    float apex_dx = SDL_min(
+        SDL_fabsf(landing.x - takeoff.x), PLAYER_RUN_VELOCITY * apex_t
+    );
+    Vector2f apex = {
+        takeoff.x + (to_x > from_x ? apex_dx : -apex_dx), takeoff.y - apex_h
+    };
+    return MapHasLineOfSight(map, takeoff, apex) &&
+           MapHasLineOfSight(map, apex, landing);
+}
+
+// highest a jump can reach (in tiles)
+float GetNavMaxRise(Map* map) {
+    return PLAYER_JUMP_VELOCITY * PLAYER_JUMP_VELOCITY / (2.0f * GRAVITY_Y) /
+           map->tilemap->tileheight;
+}
+
+/*
+  Add the jump edge from span `from` to span `to`, if there is one.
+*/
+void AddJumpEdge(NavGraph* graph, Map* map, int* capacity, int from, int to) {
+    NavSpan* a = &graph->spans[from];
+    NavSpan* b = &graph->spans[to];
+    int dy = b->y - a->y;
+    int max_rise = (int)GetNavMaxRise(map);
+    if (to == from || dy < -max_rise || dy > NAV_MAX_JUMP_DROP) {
+        return;
+    }
+    // try to land on either end of `b`, leaving from the nearest tile of `a`
+    // outside of `b`
+    int best_from_x = -1, best_to_x = -1, best_dx = 0;
+    for (int side = 0; side < 2; ++side) {
+        int to_x = side ? b->x1 : b->x0;
+        int from_x = SDL_clamp(to_x + (side ? 1 : -1), a->x0, a->x1);
+        int dx = SDL_abs(to_x - from_x);
+        if ((best_from_x < 0 || dx < best_dx) &&
+            CanJump(map, from_x, a->y, to_x, b->y)) {
+            best_from_x = from_x;
+            best_to_x = to_x;
+            best_dx = dx;
+        }
+    }
+    if (best_from_x >= 0) {
+        float cost =
+            SDL_sqrtf((float)(best_dx * best_dx + dy * dy)) + NAV_JUMP_PENALTY;
+        AddNavEdge(
+            graph, capacity, NAV_EDGE_JUMP, from, to, best_from_x, best_to_x,
+            cost
+        );
+    }
+}
+
+/*
+  Tiles which a jump between spans `a` and `b` may pass through, a bit larger
+  than the arcs tested by `CanJump`.
+*/
+SDL_Rect GetNavJumpArea(Map* map, NavSpan* a, NavSpan* b) {
+    int max_rise = (int)SDL_ceilf(GetNavMaxRise(map));
+    int x0 = SDL_min(a->x0, b->x0) - 1;
+    int x1 = SDL_max(a->x1, b->x1) + 1;
+    int y0 = SDL_min(a->y, b->y) - max_rise - 1;
+    int y1 = SDL_max(a->y, b->y) + 1;
+    return (SDL_Rect){x0, y0, x1 - x0 + 1, y1 - y0 + 1};
+}
+
+void AddFallEdges(NavGraph* graph, Map* map, int* capacity, int from) {
+    NavSpan* a = &graph->spans[from];
+    for (int side = 0; side < 2; ++side) {
+        int x = side ? a->x1 + 1 : a->x0 - 1;
+        if (!IsNavCellEmpty(map, x, a->y)) {
+            continue;
+        }
+        for (int y = a->y + 1; y < graph->height; ++y) {
+            int to = graph->span_at[y * graph->width + x];
+            if (to >= 0) {
+                AddNavEdge(
+                    graph, capacity, NAV_EDGE_FALL, from, to,
+                    side ? a->x1 : a->x0, x,
+                    (float)(y - a->y + 1) + NAV_FALL_PENALTY
+                );
+                break;
+            }
+            // never fall onto spikes or through the floor
+            if (!IsNavCellEmpty(map, x, y)) {
+                break;
+            }
+        }
+    }
+}
+
+void BuildNavSpans(NavGraph* graph, Map* map) {
+    graph->span_count = 0;
+    graph->span_at = malloc(graph->width * graph->height * sizeof(int));
+    int span_capacity = 0;
+    for (int y = 0; y < graph->height; ++y) {
+        for (int x = 0; x < graph->width; ++x) {
+            graph->span_at[y * graph->width + x] = -1;
+            if (!IsNavCellEmpty(map, x, y) || !IsNavCellGround(map, x, y + 1)) {
+                continue;
+            }
+            if (x > 0 && graph->span_at[y * graph->width + x - 1] >= 0) {
+                int index = graph->span_at[y * graph->width + x - 1];
+                graph->spans[index].x1 = x;
+                graph->span_at[y * graph->width + x] = index;
+                continue;
+            }
+            if (graph->span_count == span_capacity) {
+                span_capacity = span_capacity ? 2 * span_capacity : 64;
+                graph->spans =
+                    realloc(graph->spans, span_capacity * sizeof(NavSpan));
+            }
+            graph->spans[graph->span_count] = (NavSpan){y, x, x, 0, 0};
+            graph->span_at[y * graph->width + x] = graph->span_count++;
+        }
+    }
+}
+
+/*
+  Find the spans and edges of `graph`, whose arrays must be empty.
+
+  `old` is the graph before `SetMapTile` changed the tiles in `graph->dirty`,
+  or `NULL`. A span found at the same place in `old` keeps its jumps to the
+  other unchanged spans, unless the jump may pass through a changed tile, so
+  only the jumps near the change are tested again. Falls are cheap and always
+  found again.
+*/
+void BuildNavGraph(NavGraph* graph, Map* map, NavGraph* old) {
+    BuildNavSpans(graph, map);
+    // the same span in `old` for every span, or -1 if it is new
+    int* old_index = malloc((graph->span_count + 1) * sizeof(int));
+    int* new_index = NULL;
+    if (old) {
+        new_index = malloc((old->span_count + 1) * sizeof(int));
+        for (int i = 0; i < old->span_count; ++i) {
+            new_index[i] = -1;
+        }
+    }
+    for (int i = 0; i < graph->span_count; ++i) {
+        NavSpan* span = &graph->spans[i];
+        int index = old ? old->span_at[span->y * old->width + span->x0] : -1;
+        old_index[i] = -1;
+        if (index >= 0 && old->spans[index].x0 == span->x0 &&
+            old->spans[index].x1 == span->x1) {
+            old_index[i] = index;
+            new_index[index] = i;
+        }
+    }
+    // `copied[to] == from` if the jump from `from` to `to` was copied
+    int* copied = malloc((graph->span_count + 1) * sizeof(int));
+    for (int i = 0; i < graph->span_count; ++i) {
+        copied[i] = -1;
+    }
+    graph->edge_count = 0;
+    int edge_capacity = 0;
+    for (int from = 0; from < graph->span_count; ++from) {
+        NavSpan* a = &graph->spans[from];
+        a->first_edge = graph->edge_count;
+        AddFallEdges(graph, map, &edge_capacity, from);
+        if (old_index[from] >= 0) {
+            NavSpan* old_a = &old->spans[old_index[from]];
+            for (int i = 0; i < old_a->edge_count; ++i) {
+                NavEdge* edge = &old->edges[old_a->first_edge + i];
+                if (edge->type != NAV_EDGE_JUMP || new_index[edge->to] < 0) {
+                    continue;
+                }
+                int to = new_index[edge->to];
+                SDL_Rect area = GetNavJumpArea(map, a, &graph->spans[to]);
+                if (!SDL_HasIntersection(&area, &graph->dirty)) {
+                    AddNavEdge(
+                        graph, &edge_capacity, NAV_EDGE_JUMP, from, to,
+                        edge->from_x, edge->to_x, edge->cost
+                    );
+                    copied[to] = from;
+                }
+            }
+        }
+        for (int to = 0; to < graph->span_count; ++to) {
+            if (copied[to] == from) {
+                continue;
+            }
+            // two unchanged spans away from the change had no jump either
+            if (old_index[from] >= 0 && old_index[to] >= 0) {
+                SDL_Rect area = GetNavJumpArea(map, a, &graph->spans[to]);
+                if (!SDL_HasIntersection(&area, &graph->dirty)) {
+                    continue;
+                }
+            }
+            AddJumpEdge(graph, map, &edge_capacity, from, to);
+        }
+        a->edge_count = graph->edge_count - a->first_edge;
+    }
+    free(old_index);
+    free(new_index);
+    free(copied);
+    graph->search.cost =
+        realloc(graph->search.cost, graph->span_count * sizeof(float));
+    graph->search.came_from =
+        realloc(graph->search.came_from, graph->span_count * sizeof(int));
+    graph->search.arrive_x =
+        realloc(graph->search.arrive_x, graph->span_count * sizeof(int));
+    graph->search.closed =
+        realloc(graph->search.closed, graph->span_count * sizeof(Uint8));
+    // every span is expanded once, so each edge is pushed at most once
+    graph->search.heap = realloc(
+        graph->search.heap, (graph->edge_count + 1) * sizeof(int) * 2
+    );
+    for (int i = 0; i < NAV_PATH_CACHE_SIZE; ++i) {
+        free(graph->cache[i].path.steps);
+        graph->cache[i] = (NavPathCacheEntry){-1, -1, {0, NULL}};
+    }
+    graph->is_dirty = 0;
+    graph->dirty = (SDL_Rect){0, 0, 0, 0};
+}
+
+/*
+  Mark tile (x, y) as changed. The graph is updated around the changed tiles
+  before the next query.
+*/
+void MarkNavGraphDirty(NavGraph* graph, int x, int y) {
+    SDL_Rect tile = {x, y, 1, 1};
+    if (graph->is_dirty) {
+        SDL_UnionRect(&graph->dirty, &tile, &graph->dirty);
+    } else {
+        graph->dirty = tile;
+    }
+    graph->is_dirty = 1;
+}
+
+void UpdateNavGraph(NavGraph* graph, Map* map) {
+    NavGraph old = *graph;
+    graph->spans = NULL;
+    graph->span_at = NULL;
+    graph->edges = NULL;
+    BuildNavGraph(graph, map, &old);
+    free(old.spans);
+    free(old.span_at);
+    free(old.edges);
+}
+
+/*
+  Build the navigation graph from the collision grid of `map`. Spans are
+  connected by falling off their ends and by jumps that fit the player's
+  physics (`GRAVITY_Y`, `PLAYER_JUMP_VELOCITY`, `PLAYER_RUN_VELOCITY`).
+*/
+NavGraph* CreateNavGraph(Map* map) {
+    NavGraph* graph = calloc(1, sizeof(NavGraph));
+    graph->width = map->collision.width;
+    graph->height = map->collision.height;
+    BuildNavGraph(graph, map, NULL);
+    return graph;
+}
+
+void FreeNavGraph(NavGraph* graph) {
+    for (int i = 0; i < NAV_PATH_CACHE_SIZE; ++i) {
+        free(graph->cache[i].path.steps);
+    }
+    free(graph->spans);
+    free(graph->edges);
+    free(graph->span_at);
+    free(graph->search.cost);
+    free(graph->search.came_from);
+    free(graph->search.arrive_x);
+    free(graph->search.closed);
+    free(graph->search.heap);
+    free(graph);
+}
+
+/*
+  Find the span `pos` (in pixels, usually the feet of an entity) stands on. An
+  entity in the air belongs to the first span below it. Return -1 if there is
+  none.
+*/
+int FindNavSpan(NavGraph* graph, Map* map, Vector2f pos) {
+    int x = (int)SDL_floorf(pos.x / map->tilemap->tilewidth);
+    int y = (int)SDL_floorf((pos.y - 1.0f) / map->tilemap->tileheight);
+    if (x < 0 || x >= graph->width) {
+        return -1;
+    }
+    for (y = SDL_max(y, 0); y < graph->height; ++y) {
+        int index = graph->span_at[y * graph->width + x];
+        if (index >= 0) {
+            return index;
+        }
+        if (!IsNavCellEmpty(map, x, y)) {
+            break;
+        }
+    }
+    return -1;
+}
+
+/*
+  The heap stores (cost, span) pairs packed into two ints, ordered by cost.
+*/
+void PushNavHeap(int* heap, int* size, float cost, int span) {
+    int i = (*size)++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        float parent_cost;
+        memcpy(&parent_cost, &heap[parent * 2], sizeof(float));
+        if (parent_cost <= cost) {
+            break;
+        }
+        heap[i * 2] = heap[parent * 2];
+        heap[i * 2 + 1] = heap[parent * 2 + 1];
+        i = parent;
+    }
+    memcpy(&heap[i * 2], &cost, sizeof(float));
+    heap[i * 2 + 1] = span;
+}
+
+int PopNavHeap(int* heap, int* size) {
+    int top = heap[1];
+    int last = --(*size);
+    float cost;
+    memcpy(&cost, &heap[last * 2], sizeof(float));
+    int i = 0;
+    while (2 * i + 1 < *size) {
+        int child = 2 * i + 1;
+        float child_cost, right_cost;
+        memcpy(&child_cost, &heap[child * 2], sizeof(float));
+        if (child + 1 < *size) {
+            memcpy(&right_cost, &heap[(child + 1) * 2], sizeof(float));
+            if (right_cost < child_cost) {
+                ++child;
+                child_cost = right_cost;
+            }
+        }
+        if (cost <= child_cost) {
+            break;
+        }
+        heap[i * 2] = heap[child * 2];
+        heap[i * 2 + 1] = heap[child * 2 + 1];
+        i = child;
+    }
+    heap[i * 2] = heap[last * 2];
+    heap[i * 2 + 1] = heap[last * 2 + 1];
+    return top;
+}
+
+float NavHeuristic(NavGraph* graph, int span, int x, int goal, int goal_x) {
+    float dx = (float)(goal_x - x);
+    float dy = (float)(graph->spans[goal].y - graph->spans[span].y);
+    return SDL_sqrtf(dx * dx + dy * dy);
+}
+
+/*
+  A* over spans. The cost of a span includes walking from where it was landed
+  on to where the next edge leaves from. On success `path` is filled with the
+  steps from `from` to `to_x` on span `to`.
+*/
+int SearchNavPath(
+    NavGraph* graph, int from, int from_x, int to, int to_x, NavPath* path
+) {
+    float* cost = graph->search.cost;
+    int* came_from = graph->search.came_from;
+    int* arrive_x = graph->search.arrive_x;
+    Uint8* closed = graph->search.closed;
+    int* heap = graph->search.heap;
+    int heap_size = 0;
+    for (int i = 0; i < graph->span_count; ++i) {
+        cost[i] = -1.0f;
+        came_from[i] = -1;
+        closed[i] = 0;
+    }
+    cost[from] = 0.0f;
+    arrive_x[from] = from_x;
+    PushNavHeap(heap, &heap_size, 0.0f, from);
+    while (heap_size > 0) {
+        int span = PopNavHeap(heap, &heap_size);
+        if (span == to) {
+            break;
+        }
+        if (closed[span]) {
+            continue;
+        }
+        closed[span] = 1;
+        NavSpan* now = &graph->spans[span];
+        for (int i = 0; i < now->edge_count; ++i) {
+            int edge_index = now->first_edge + i;
+            NavEdge* edge = &graph->edges[edge_index];
+            if (closed[edge->to]) {
+                continue;
+            }
+            float new_cost = cost[span] +
+                             (float)SDL_abs(edge->from_x - arrive_x[span]) +
+                             edge->cost;
+            // the goal's cost includes the walk to `to_x`, otherwise a
+            // landing far from it may be popped first
+            float estimate =
+                NavHeuristic(graph, edge->to, edge->to_x, to, to_x);
+            if (edge->to == to) {
+                new_cost += estimate;
+                estimate = 0.0f;
+            }
+            if (cost[edge->to] >= 0.0f && cost[edge->to] <= new_cost) {
+                continue;
+            }
+            cost[edge->to] = new_cost;
+            came_from[edge->to] = edge_index;
+            arrive_x[edge->to] = edge->to_x;
+            PushNavHeap(heap, &heap_size, new_cost + estimate, edge->to);
+        }
+    }
+    if (cost[to] < 0.0f) {
+        return 0;
+    }
+    // one step per edge, plus the final walk on the goal span
+    int count = 1;
+    for (int span = to; span != from;
+         span = graph->edges[came_from[span]].from) {
+        ++count;
+    }
+    path->count = count;
+    path->steps = malloc(count * sizeof(NavStep));
+    int goal_y = graph->spans[to].y;
+    path->steps[count - 1] = (NavStep){
+        NAV_EDGE_WALK, {arrive_x[to], goal_y}, {to_x, goal_y}
+    };
+    for (int span = to, i = count - 2; span != from; --i) {
+        NavEdge* edge = &graph->edges[came_from[span]];
+        path->steps[i] = (NavStep){
+            edge->type,
+            {edge->from_x, graph->spans[edge->from].y},
+            {edge->to_x, graph->spans[edge->to].y}
+        };
+        span = edge->from;
+    }
+    return 1;
+}
+
+/*
+  Find a path between two points (in pixels) of `map`. Paths are cached per
+  pair of spans, so entities following each other share the search.
+
+  The returned path is owned by the graph and is only valid until the next
+  call, copy it if it should be kept. Return `NULL` if there is no path.
+*/
+NavPath* FindNavPath(Map* map, Vector2f from, Vector2f to) {
+    NavGraph* graph = map->nav;
+    if (graph->is_dirty) {
+        UpdateNavGraph(graph, map);
+    }
+    int from_span = FindNavSpan(graph, map, from);
+    int to_span = FindNavSpan(graph, map, to);
+    if (from_span < 0 || to_span < 0) {
+        return NULL;
+    }
+    unsigned int hash = (unsigned int)from_span * 2654435761u ^
+                        (unsigned int)to_span * 40503u;
+    NavPathCacheEntry* entry = &graph->cache[hash % NAV_PATH_CACHE_SIZE];
+    if (entry->from != from_span || entry->to != to_span) {
+        free(entry->path.steps);
+        *entry = (NavPathCacheEntry){from_span, to_span, {0, NULL}};
+        SearchNavPath(
+            graph, from_span, (int)SDL_floorf(from.x / map->tilemap->tilewidth),
+            to_span, (int)SDL_floorf(to.x / map->tilemap->tilewidth),
+            &entry->path
+        );
+    }
+    if (!entry->path.steps) {
+        return NULL;
+    }
+    // the spans match, but the exact tiles may differ from the cached query
+    NavStep* last = &entry->path.steps[entry->path.count - 1];
+    last->to.x = (int)SDL_floorf(to.x / map->tilemap->tilewidth);
+    if (entry->path.count == 1) {
+        last->from.x = (int)SDL_floorf(from.x / map->tilemap->tilewidth);
+    }
+    return &entry->path;
+}
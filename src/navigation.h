@@ -0,0 +1,115 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef TH_NAVIGATION_H_
+#define TH_NAVIGATION_H_
+
+#include "global.h"
+#include <SDL.h>
+
+#define NAV_PATH_CACHE_SIZE 64
+// lowest landing below the takeoff of a jump edge (in tiles)
+#define NAV_MAX_JUMP_DROP 4
+
+struct Map;
+typedef struct Map Map;
+
+typedef enum NavEdgeType {
+    NAV_EDGE_WALK,
+    NAV_EDGE_FALL,
+    NAV_EDGE_JUMP
+} NavEdgeType;
+
+/*
+  A walkable surface: tiles (x0..x1, y) are empty and every tile below them is
+  solid ground.
+*/
+typedef struct NavSpan {
+    int y;
+    int x0;
+    int x1;
+    int first_edge;
+    int edge_count;
+} NavSpan;
+
+typedef struct NavEdge {
+    NavEdgeType type;
+    int from;
+    int to;
+    // tile to leave from in the source span and tile to land on
+    int from_x;
+    int to_x;
+    float cost;
+} NavEdge;
+
+/*
+  Walk along the current span to `from`, then take the `type` move to `to`.
+  All coordinates are in tiles.
+*/
+typedef struct NavStep {
+    NavEdgeType type;
+    Vector2 from;
+    Vector2 to;
+} NavStep;
+
+typedef struct NavPath {
+    int count;
+    NavStep* steps;
+} NavPath;
+
+typedef struct NavPathCacheEntry {
+    int from;
+    int to;
+    NavPath path;
+} NavPathCacheEntry;
+
+typedef struct NavGraph {
+    int width;
+    int height;
+    int span_count;
+    NavSpan* spans;
+    int edge_count;
+    NavEdge* edges;
+    // index of the span each tile belongs to, or -1
+    int* span_at;
+    // set by `SetMapTile`, the graph is updated before the next query
+    int is_dirty;
+    // tiles changed since the graph was built
+    SDL_Rect dirty;
+    // scratch buffers of A*, sized by `span_count` and `edge_count`
+    struct {
+        float* cost;
+        int* came_from;
+        int* arrive_x;
+        Uint8* closed;
+        int* heap;
+    } search;
+    NavPathCacheEntry cache[NAV_PATH_CACHE_SIZE];
+} NavGraph;
+
+NavGraph* CreateNavGraph(Map* map);
+void FreeNavGraph(NavGraph* graph);
+void MarkNavGraphDirty(NavGraph* graph, int x, int y);
+int FindNavSpan(NavGraph* graph, Map* map, Vector2f pos);
+NavPath* FindNavPath(Map* map, Vector2f from, Vector2f to);
+
+#endif
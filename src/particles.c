@@ -0,0 +1,260 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "particles.h"
+#include "entities/base.h"
+#include "image/image.h"
+#include "resource/loader.h"
+#include "scenes/world.h"
+
+// the pieces of a broken barrel, with a white square on their right
+#define PARTICLE_ATLAS_WIDTH 68
+#define PARTICLE_ATLAS_HEIGHT 14
+
+extern GameApp game_app;
+
+/*
+  How one effect looks. Every particle gets a random value between the
+  minimum and the maximum, and the frames from `frame` are used in turn.
+*/
+typedef struct ParticleEmitter {
+    int count;
+    ParticleFrame frame;
+    int frame_count;
+    float min_size;
+    float max_size;
+    SDL_Color color;
+    Vector2f min_velocity;
+    Vector2f max_velocity;
+    float gravity;
+    float min_life;
+    float max_life;
+} ParticleEmitter;
+
+ParticleEmitter particle_emitters[] = {
+    [PARTICLE_EFFECT_DUST] =
+        {8, PARTICLE_FRAME_SOLID, 1, 2, 3, {222, 212, 190, 192}, {-30, -30},
+         {30, -8}, GRAVITY_Y / 6.0f, 0.3, 0.5},
+    [PARTICLE_EFFECT_SPARKS] =
+        {12, PARTICLE_FRAME_SOLID, 1, 1, 2, {255, 224, 128, 255},
+         {-120, -120}, {120, -20}, GRAVITY_Y, 0.15, 0.3},
+    [PARTICLE_EFFECT_DEBRIS] =
+        {4, PARTICLE_FRAME_DEBRIS1, 4, 1, 1, {255, 255, 255, 255},
+         {-80, -160}, {80, -80}, GRAVITY_Y, 0.8, 1.2}
+};
+// the middle of the white square, so that filtering never samples its edge
+SDL_Rect particle_frame_rect[PARTICLE_FRAME_COUNT] = {
+    {65, 1, 2, 2}, {0, 0, 16, 14}, {16, 0, 16, 14}, {32, 0, 16, 14},
+    {48, 0, 16, 14}
+};
+Vector2f particle_frame_size[PARTICLE_FRAME_COUNT] = {
+    {1, 1}, {16, 14}, {16, 14}, {16, 14}, {16, 14}
+};
+SDL_Texture* particle_atlas = NULL;
+
+/*
+  Put every particle frame into one texture, so that all particles are drawn
+  with a single call.
+*/
+void InitParticleSystem() {
+    if (!game_app.renderer) {
+        return;
+    }
+    SDL_Surface* atlas = SDL_CreateRGBSurfaceWithFormat(
+        0, PARTICLE_ATLAS_WIDTH, PARTICLE_ATLAS_HEIGHT, 32,
+        SDL_PIXELFORMAT_ARGB8888
+    );
+    if (!atlas) {
+        return;
+    }
+    SDL_FillRect(
+        atlas, &(SDL_Rect){64, 0, 4, 4},
+        SDL_MapRGBA(atlas->format, 255, 255, 255, 255)
+    );
+    SDL_Surface* debris = LoadSurface("images/objects/barrel_destroyed.png");
+    if (debris) {
+        SDL_SetSurfaceBlendMode(debris, SDL_BLENDMODE_NONE);
+        SDL_BlitSurface(debris, NULL, atlas, NULL);
+        SDL_FreeSurface(debris);
+    }
+    particle_atlas = SDL_CreateTextureFromSurface(game_app.renderer, atlas);
+    SDL_SetTextureBlendMode(particle_atlas, SDL_BLENDMODE_BLEND);
+    SDL_FreeSurface(atlas);
+}
+
+void QuitParticleSystem() {
+    if (particle_atlas) {
+        SDL_DestroyTexture(particle_atlas);
+        particle_atlas = NULL;
+    }
+}
+
+/*
+  Create a pool of `capacity` particles which lives as long as `arena`.
+*/
+ParticlePool* CreateParticlePool(Arena* arena, int capacity) {
+    ParticlePool* pool = ArenaCalloc(arena, 1, sizeof(ParticlePool));
+    pool->capacity = capacity;
+    pool->x = ArenaAlloc(arena, capacity * sizeof(float));
+    pool->y = ArenaAlloc(arena, capacity * sizeof(float));
+    pool->vx = ArenaAlloc(arena, capacity * sizeof(float));
+    pool->vy = ArenaAlloc(arena, capacity * sizeof(float));
+    pool->gravity = ArenaAlloc(arena, capacity * sizeof(float));
+    pool->life = ArenaAlloc(arena, capacity * sizeof(float));
+    pool->lifetime = ArenaAlloc(arena, capacity * sizeof(float));
+    pool->size = ArenaAlloc(arena, capacity * sizeof(float));
+    pool->frame = ArenaAlloc(arena, capacity * sizeof(Uint8));
+    pool->color = ArenaAlloc(arena, capacity * sizeof(SDL_Color));
+    pool->seed = 0x2545f491;
+    return pool;
+}
+
+/*
+  A uniform random number in `[min, max]`, from the xorshift generator of the
+  pool.
+*/
+float RandomParticleFloat(ParticlePool* pool, float min, float max) {
+    Uint32 x = pool->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    pool->seed = x;
+    return min + (max - min) * (x >> 8) / (float)(1 << 24);
+}
+
+/*
+  Emit the particles of `effect` around `(x, y)`, as many as fit.
+*/
+void EmitParticles(
+    ParticlePool* pool, ParticleEffect effect, float x, float y
+) {
+    ParticleEmitter* emitter = &particle_emitters[effect];
+    for (int i = 0; i < emitter->count && pool->count < pool->capacity; ++i) {
+        int n = pool->count++;
+        pool->x[n] = x;
+        pool->y[n] = y;
+        pool->vx[n] = RandomParticleFloat(
+            pool, emitter->min_velocity.x, emitter->max_velocity.x
+        );
+        pool->vy[n] = RandomParticleFloat(
+            pool, emitter->min_velocity.y, emitter->max_velocity.y
+        );
+        pool->gravity[n] = emitter->gravity;
+        pool->lifetime[n] =
+            RandomParticleFloat(pool, emitter->min_life, emitter->max_life);
+        pool->life[n] = pool->lifetime[n];
+        pool->size[n] =
+            RandomParticleFloat(pool, emitter->min_size, emitter->max_size);
+        pool->frame[n] = emitter->frame + i % emitter->frame_count;
+        pool->color[n] = emitter->color;
+    }
+}
+
+/*
+  Move every particle by one step. The loop has no branches and only reads
+  and writes arrays of floats, so the compiler can vectorize it.
+*/
+void IntegrateParticles(ParticlePool* pool, float dt) {
+    int count = pool->count;
+    float* x = pool->x;
+    float* y = pool->y;
+    float* vx = pool->vx;
+    float* vy = pool->vy;
+    float* gravity = pool->gravity;
+    float* life = pool->life;
+    for (int i = 0; i < count; ++i) {
+        vy[i] += gravity[i] * dt;
+        x[i] += vx[i] * dt;
+        y[i] += vy[i] * dt;
+        life[i] -= dt;
+    }
+}
+
+/*
+  Advance all particles by `dt` seconds and drop the dead ones.
+*/
+void UpdateParticles(ParticlePool* pool, float dt) {
+    IntegrateParticles(pool, dt);
+    int i = 0;
+    while (i < pool->count) {
+        if (pool->life[i] > 0) {
+            ++i;
+            continue;
+        }
+        int last = --pool->count;
+        pool->x[i] = pool->x[last];
+        pool->y[i] = pool->y[last];
+        pool->vx[i] = pool->vx[last];
+        pool->vy[i] = pool->vy[last];
+        pool->gravity[i] = pool->gravity[last];
+        pool->life[i] = pool->life[last];
+        pool->lifetime[i] = pool->lifetime[last];
+        pool->size[i] = pool->size[last];
+        pool->frame[i] = pool->frame[last];
+        pool->color[i] = pool->color[last];
+    }
+}
+
+/*
+  Submit the live particles which the camera can see as one command, so that
+  they are drawn with one `SDL_RenderGeometry`. Like entities, they are drawn
+  `alpha` of a simulation step after the last one, which is the same as going
+  back along the velocity. They fade out in the second half of their life.
+*/
+void DrawParticles(ParticlePool* pool, Camera* camera, float alpha) {
+    if (!particle_atlas || pool->count == 0) {
+        return;
+    }
+    PushRenderLayer(RENDER_LAYER_PARTICLES, RENDER_ORDER_BY_TEXTURE);
+    SDL_Vertex* vertices = SubmitQuads(particle_atlas, pool->count);
+    SDL_FRect visible = GetVisibleRect(camera);
+    float scale = camera->scale;
+    float lag = (1 - alpha) * SIMULATION_STEP;
+    int count = 0;
+    for (int i = 0; i < pool->count; ++i) {
+        float x = pool->x[i] - pool->vx[i] * lag;
+        float y = pool->y[i] - pool->vy[i] * lag;
+        if (x < visible.x || x > visible.x + visible.w || y < visible.y ||
+            y > visible.y + visible.h) {
+            continue;
+        }
+        SDL_Rect* rect = &particle_frame_rect[pool->frame[i]];
+        Vector2f* size = &particle_frame_size[pool->frame[i]];
+        float u0 = (float)rect->x / PARTICLE_ATLAS_WIDTH;
+        float v0 = (float)rect->y / PARTICLE_ATLAS_HEIGHT;
+        float u1 = (float)(rect->x + rect->w) / PARTICLE_ATLAS_WIDTH;
+        float v1 = (float)(rect->y + rect->h) / PARTICLE_ATLAS_HEIGHT;
+        float cx = x * scale + camera->offset.x;
+        float cy = y * scale + camera->offset.y;
+        float hw = size->x * pool->size[i] * scale / 2;
+        float hh = size->y * pool->size[i] * scale / 2;
+        SDL_Color color = pool->color[i];
+        color.a *= SDL_min(1, 2 * pool->life[i] / pool->lifetime[i]);
+        SDL_Vertex* vertex = &vertices[4 * count++];
+        vertex[0] = (SDL_Vertex){{cx - hw, cy - hh}, color, {u0, v0}};
+        vertex[1] = (SDL_Vertex){{cx + hw, cy - hh}, color, {u1, v0}};
+        vertex[2] = (SDL_Vertex){{cx + hw, cy + hh}, color, {u1, v1}};
+        vertex[3] = (SDL_Vertex){{cx - hw, cy + hh}, color, {u0, v1}};
+    }
+    TrimSubmittedQuads(count);
+    PopRenderLayer();
+}
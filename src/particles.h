@@ -0,0 +1,98 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef TH_PARTICLES_H_
+#define TH_PARTICLES_H_
+
+#include "arena.h"
+#include "camera.h"
+#include "global.h"
+#include <SDL.h>
+
+// particles alive at once in the pool of a map
+#if defined(__PSP__)
+    #define MAX_PARTICLES 2048
+#else
+    #define MAX_PARTICLES 32768
+#endif
+
+typedef enum ParticleEffect {
+    // a puff of dust where something landed
+    PARTICLE_EFFECT_DUST,
+    // sparks of a sword hitting something
+    PARTICLE_EFFECT_SPARKS,
+    // pieces of a broken barrel
+    PARTICLE_EFFECT_DEBRIS
+} ParticleEffect;
+
+/*
+  Regions of the particle atlas. A solid particle is a square of one colour,
+  the others are pictures.
+*/
+typedef enum ParticleFrame {
+    PARTICLE_FRAME_SOLID,
+    PARTICLE_FRAME_DEBRIS1,
+    PARTICLE_FRAME_DEBRIS2,
+    PARTICLE_FRAME_DEBRIS3,
+    PARTICLE_FRAME_DEBRIS4,
+    PARTICLE_FRAME_COUNT
+} ParticleFrame;
+
+/*
+  A fixed number of particles in parallel arrays, the live ones are in
+  `[0, count)`. A dead particle is replaced by the last one, so their order
+  changes. Emitting into a full pool does nothing.
+
+  Particles do not collide with anything and nothing reads them back, they
+  are only drawn.
+*/
+typedef struct ParticlePool {
+    int count;
+    int capacity;
+    // position of the centre and velocity, in map pixels
+    float* x;
+    float* y;
+    float* vx;
+    float* vy;
+    float* gravity;
+    // seconds left to live, and seconds the particle lived in total
+    float* life;
+    float* lifetime;
+    // scale of the frame, a solid frame is one pixel
+    float* size;
+    Uint8* frame;
+    SDL_Color* color;
+    // particles have a random generator of their own, so that they do not
+    // change the sequence of `rand()` which replays depend on
+    Uint32 seed;
+} ParticlePool;
+
+void InitParticleSystem();
+void QuitParticleSystem();
+ParticlePool* CreateParticlePool(Arena* arena, int capacity);
+void EmitParticles(
+    ParticlePool* pool, ParticleEffect effect, float x, float y
+);
+void UpdateParticles(ParticlePool* pool, float dt);
+void DrawParticles(ParticlePool* pool, Camera* camera, float alpha);
+
+#endif
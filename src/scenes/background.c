@@ -27,12 +27,20 @@
 
 extern GameApp game_app;
 
-SDL_Texture* background_texture = NULL;
+// static layers are behind the small clouds, scrolling layers in front
+ParallaxLayer parallax_layers[] = {
+    {PARALLAX_LAYER_STATIC, "images/background/background_sky.png", 1.0, 1.0},
+    {PARALLAX_LAYER_SCROLLING, "images/background/big_cloud.png", 0.675, 0.67,
+     30}
+};
+// the static layers drawn at the size of the view
+SDL_Texture* background_cache = NULL;
+int background_cache_w = 0;
+int background_cache_h = 0;
 SDL_Texture* small_cloud_texture[3] = {NULL, NULL, NULL};
+Vector2 small_cloud_size[3];
 float small_cloud_x = 20.0;
 int small_cloud_index = 0;
-SDL_Texture* big_cloud_texture = NULL;
-float big_cloud_x = 0;
 SDL_Texture* water_reflect_big_texture = NULL;
 SDL_Rect water_reflect_big_animation_clip[] = {
     RectFromImageGrid(170, 40, 4, 1, 0, 0),
@@ -59,11 +67,22 @@ SDL_Rect water_reflect_small_animation_clip[] = {
 Animation* water_reflect_small_animation = NULL;
 
 void InitBackground() {
-    background_texture = LoadTexture("images/background/background_sky.png");
+    for (int i = 0; i < SDL_arraysize(parallax_layers); ++i) {
+        ParallaxLayer* layer = &parallax_layers[i];
+        layer->texture = LoadTexture(layer->path);
+        SDL_QueryTexture(
+            layer->texture, NULL, NULL, &layer->texture_w, &layer->texture_h
+        );
+    }
     small_cloud_texture[0] = LoadTexture("images/background/small_cloud1.png");
     small_cloud_texture[1] = LoadTexture("images/background/small_cloud2.png");
     small_cloud_texture[2] = LoadTexture("images/background/small_cloud3.png");
-    big_cloud_texture = LoadTexture("images/background/big_cloud.png");
+    for (int i = 0; i < SDL_arraysize(small_cloud_texture); ++i) {
+        SDL_QueryTexture(
+            small_cloud_texture[i], NULL, NULL, &small_cloud_size[i].x,
+            &small_cloud_size[i].y
+        );
+    }
     water_reflect_big_texture =
         LoadTexture("images/background/water_reflect_big.png");
     water_reflect_big_animation = CreateAnimation(
@@ -85,11 +104,15 @@ void InitBackground() {
 }
 
 void QuitBackground() {
-    SDL_DestroyTexture(background_texture);
+    for (int i = 0; i < SDL_arraysize(parallax_layers); ++i) {
+        SDL_DestroyTexture(parallax_layers[i].texture);
+    }
+    if (background_cache != NULL) {
+        SDL_DestroyTexture(background_cache);
+    }
     for (int i = 0; i < SDL_arraysize(small_cloud_texture); ++i) {
         SDL_DestroyTexture(small_cloud_texture[i]);
     }
-    SDL_DestroyTexture(big_cloud_texture);
     FreeAnimation(water_reflect_big_animation);
     FreeAnimation(water_reflect_medium_animation);
     FreeAnimation(water_reflect_small_animation);
@@ -98,47 +121,123 @@ void QuitBackground() {
     SDL_DestroyTexture(water_reflect_small_texture);
 }
 
+SDL_FRect GetParallaxLayerRect(ParallaxLayer* layer, int view_w, int view_h) {
+    float h = layer->height * view_h;
+    float w = layer->type == PARALLAX_LAYER_STATIC
+                ? view_w
+                : (float)layer->texture_w * h / layer->texture_h;
+    return (SDL_FRect){0, layer->bottom * view_h - h, w, h};
+}
+
+#if !defined(__PSP__)
+/*
+  Draw the static layers into `background_cache`. This only happens when the
+  size of the view changes, every other frame copies the cache.
+*/
+void RebuildBackgroundCache(int view_w, int view_h) {
+    if (background_cache != NULL) {
+        DestroyTextureAfterFlush(background_cache);
+    }
+    background_cache_w = view_w;
+    background_cache_h = view_h;
+    background_cache = SDL_CreateTexture(
+        game_app.renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+        view_w, view_h
+    );
+    if (background_cache == NULL) {
+        return;
+    }
+    SDL_SetTextureBlendMode(background_cache, SDL_BLENDMODE_BLEND);
+    Uint8 r, g, b, a;
+    SDL_GetRenderDrawColor(game_app.renderer, &r, &g, &b, &a);
+    SDL_Texture* prev_target = SDL_GetRenderTarget(game_app.renderer);
+    SDL_SetRenderTarget(game_app.renderer, background_cache);
+    SDL_SetRenderDrawColor(game_app.renderer, 0, 0, 0, 0);
+    SDL_RenderClear(game_app.renderer);
+    for (int i = 0; i < SDL_arraysize(parallax_layers); ++i) {
+        ParallaxLayer* layer = &parallax_layers[i];
+        if (layer->type == PARALLAX_LAYER_STATIC) {
+            SDL_FRect dst = GetParallaxLayerRect(layer, view_w, view_h);
+            SDL_RenderCopyF(game_app.renderer, layer->texture, NULL, &dst);
+        }
+    }
+    SDL_SetRenderTarget(game_app.renderer, prev_target);
+    SDL_SetRenderDrawColor(game_app.renderer, r, g, b, a);
+}
+#endif
+
+/*
+  Submit a scrolling layer as one strip of quads, which is one draw call no
+  matter how many times its texture is repeated.
+*/
+void DrawScrollingLayer(
+    ParallaxLayer* layer, int view_w, int view_h, float dt
+) {
+    SDL_FRect dst = GetParallaxLayerRect(layer, view_w, view_h);
+    layer->phase += layer->speed * dt / dst.w;
+    layer->phase -= SDL_floorf(layer->phase);
+    int count = view_w / dst.w + 2;
+    SDL_Vertex* vertex = SubmitQuads(layer->texture, count);
+    for (int i = 0; i < count; ++i, vertex += 4) {
+        float x = (layer->phase - 1 + i) * dst.w;
+        vertex[0].position = (SDL_FPoint){x, dst.y};
+        vertex[1].position = (SDL_FPoint){x + dst.w, dst.y};
+        vertex[2].position = (SDL_FPoint){x + dst.w, dst.y + dst.h};
+        vertex[3].position = (SDL_FPoint){x, dst.y + dst.h};
+        vertex[0].tex_coord = (SDL_FPoint){0, 0};
+        vertex[1].tex_coord = (SDL_FPoint){1, 0};
+        vertex[2].tex_coord = (SDL_FPoint){1, 1};
+        vertex[3].tex_coord = (SDL_FPoint){0, 1};
+        for (int j = 0; j < 4; ++j) {
+            vertex[j].color = (SDL_Color){255, 255, 255, 255};
+        }
+    }
+}
+
 void DrawBackground(float dt) {
-    int win_w, win_h, img_w, img_h;
-    SDL_GetWindowSize(game_app.window, &win_w, &win_h);
-    SDL_RenderCopyF(game_app.renderer, background_texture, NULL, NULL);
+    int win_w, win_h;
+    GetRenderViewSize(&win_w, &win_h);
+    SDL_Color white = {255, 255, 255, 255};
+    PushRenderLayer(RENDER_LAYER_BACKGROUND, RENDER_ORDER_SUBMITTED);
+#if !defined(__PSP__)
+    if (win_w != background_cache_w || win_h != background_cache_h) {
+        RebuildBackgroundCache(win_w, win_h);
+    }
+#endif
+    if (background_cache != NULL) {
+        SubmitTexture(
+            background_cache, NULL, &(SDL_FRect){0, 0, win_w, win_h}, white
+        );
+    } else {
+        for (int i = 0; i < SDL_arraysize(parallax_layers); ++i) {
+            ParallaxLayer* layer = &parallax_layers[i];
+            if (layer->type == PARALLAX_LAYER_STATIC) {
+                SDL_FRect dst = GetParallaxLayerRect(layer, win_w, win_h);
+                SubmitTexture(layer->texture, NULL, &dst, white);
+            }
+        }
+    }
     // draw small clouds
-    SDL_QueryTexture(
-        small_cloud_texture[small_cloud_index], NULL, NULL, &img_w, &img_h
-    );
-    float small_cloud_scale = 0.31 * win_h / (img_h + 1);
+    Vector2 size = small_cloud_size[small_cloud_index];
+    float small_cloud_scale = 0.31 * win_h / (size.y + 1);
     small_cloud_x += 120 * dt;
     SDL_FRect small_cloud_dst = {
-        small_cloud_x, 0.31 * win_h - img_h * small_cloud_scale,
-        img_w * small_cloud_scale, img_h * small_cloud_scale
+        small_cloud_x, 0.31 * win_h - size.y * small_cloud_scale,
+        size.x * small_cloud_scale, size.y * small_cloud_scale
     };
-    SDL_RenderCopyF(
-        game_app.renderer, small_cloud_texture[small_cloud_index], NULL,
-        &small_cloud_dst
+    SubmitTexture(
+        small_cloud_texture[small_cloud_index], NULL, &small_cloud_dst, white
     );
     if (small_cloud_x > win_w) {
         small_cloud_index = rand() % 3;
-        SDL_QueryTexture(
-            small_cloud_texture[small_cloud_index], NULL, NULL, &img_w, NULL
-        );
-        small_cloud_x = -img_w * small_cloud_scale - rand() % 50 - 50;
-    }
-    // draw big cloud
-    SDL_QueryTexture(big_cloud_texture, NULL, NULL, &img_w, &img_h);
-    float big_cloud_scale = 0.67 * win_h / (img_h + 1);
-    big_cloud_x += 30 * dt;
-    while (big_cloud_x > -img_w * big_cloud_scale) {
-        big_cloud_x -= img_w * big_cloud_scale;
+        small_cloud_x = -small_cloud_size[small_cloud_index].x *
+                            small_cloud_scale -
+                        rand() % 50 - 50;
     }
-    SDL_FRect big_cloud_dst = {
-        big_cloud_x, 0.675 * win_h - img_h * big_cloud_scale,
-        img_w * big_cloud_scale, img_h * big_cloud_scale
-    };
-    for (float x = big_cloud_x; x < win_w; x += img_w * big_cloud_scale) {
-        big_cloud_dst.x = x;
-        SDL_RenderCopyF(
-            game_app.renderer, big_cloud_texture, NULL, &big_cloud_dst
-        );
+    for (int i = 0; i < SDL_arraysize(parallax_layers); ++i) {
+        if (parallax_layers[i].type == PARALLAX_LAYER_SCROLLING) {
+            DrawScrollingLayer(&parallax_layers[i], win_w, win_h, dt);
+        }
     }
     // draw water reflects
     float anime_w[] = {
@@ -148,19 +247,20 @@ void DrawBackground(float dt) {
     };
     float water_reflect_scale =
         win_w / (anime_w[0] + anime_w[1] + anime_w[2] + win_w / 20.0);
-    DrawAnimation(
+    DrawLoopedAnimation(
         water_reflect_medium_animation, win_w / 20.0, 0.69 * win_h,
         water_reflect_scale
     );
-    DrawAnimation(
+    DrawLoopedAnimation(
         water_reflect_big_animation,
         win_w / 2.0 +
             (anime_w[1] - anime_w[2] - anime_w[0]) * water_reflect_scale / 2.0,
         0.69 * win_h, water_reflect_scale
     );
-    DrawAnimation(
+    DrawLoopedAnimation(
         water_reflect_small_animation,
         0.95 * win_w - anime_w[2] * water_reflect_scale, 0.69 * win_h,
         water_reflect_scale
     );
+    PopRenderLayer();
 }
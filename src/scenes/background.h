@@ -23,6 +23,31 @@
 #ifndef TH_SCENE_BACKGROUND_H_
 #define TH_SCENE_BACKGROUND_H_
 
+#include <SDL.h>
+
+typedef enum ParallaxLayerType {
+    // fills the width of the view and never moves, all of them are drawn
+    // into one cached texture behind everything else
+    PARALLAX_LAYER_STATIC,
+    // repeated along the x axis and moved by `speed`
+    PARALLAX_LAYER_SCROLLING
+} ParallaxLayerType;
+
+typedef struct ParallaxLayer {
+    ParallaxLayerType type;
+    char* path;
+    // the bottom edge and the height of the layer, relative to the view
+    float bottom;
+    float height;
+    // pixels of the view per second
+    float speed;
+    SDL_Texture* texture;
+    int texture_w;
+    int texture_h;
+    // how far the layer has scrolled, in widths of its texture
+    float phase;
+} ParallaxLayer;
+
 void InitBackground();
 void QuitBackground();
 void DrawBackground(float dt);
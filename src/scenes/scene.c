@@ -157,3 +157,21 @@ void HandleSceneEvent(SDL_Event* event) {
 void TickScene(float dt) {
     scene_array[now_scene]->tick(dt);
 }
+
+/*
+  How many frames per second are worth drawing now. A window which nobody is
+  looking at needs only a few, and a menu needs only enough for its
+  background to move smoothly.
+*/
+int GetSceneFrameRate() {
+    // asked every frame, SDL does not always report leaving the minimized
+    // state with a `SDL_WINDOWEVENT_RESTORED`
+    if (SDL_GetWindowFlags(game_app.window) & SDL_WINDOW_MINIMIZED) {
+        return MINIMIZED_FRAME_RATE;
+    }
+    if (!game_app.window_focused) {
+        return UNFOCUSED_FRAME_RATE;
+    }
+    int frame_rate = scene_array[now_scene]->frame_rate;
+    return frame_rate > 0 ? frame_rate : FULL_FRAME_RATE;
+}
@@ -26,6 +26,11 @@
 #include <SDL.h>
 
 #define MAX_SCENE 16
+// frames per second of a scene which is being played
+#define FULL_FRAME_RATE 60
+// frames per second when nobody is looking at the window
+#define UNFOCUSED_FRAME_RATE 10
+#define MINIMIZED_FRAME_RATE 5
 
 typedef enum SceneID {
     START_SCENE,
@@ -37,6 +42,8 @@ typedef enum SceneID {
 typedef struct Scene {
     int mouse_x;
     int mouse_y;
+    // frames per second the scene needs, 0 means `FULL_FRAME_RATE`
+    int frame_rate;
     void (*init)(void);
     void (*free)(void);
     void (*tick)(float dt);
@@ -61,6 +68,7 @@ void SwitchScene(SceneID scene_id);
 void BackToPrevScene();
 void HandleSceneEvent(SDL_Event* event);
 void TickScene(float dt);
+int GetSceneFrameRate();
 void FreeScene(Scene* scene);
 
 #endif
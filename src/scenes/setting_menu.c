@@ -22,17 +22,21 @@
 
 #include "setting_menu.h"
 #include "../global.h"
+#include "../image/image.h"
+#include "../input.h"
 #include "../setting.h"
 #include "../translation.h"
 #include "../ui/text/text.h"
 #include "background.h"
 #include <SDL_mixer.h>
 #include <SDL_ttf.h>
+#include <stdio.h>
 
 extern GameApp game_app;
 extern Setting game_setting;
 
 Scene setting_scene = {
+    .frame_rate = 30,
     .init = SettingSceneInit,
     .free = SettingSceneFree,
     .tick = SettingSceneTick,
@@ -41,11 +45,19 @@ Scene setting_scene = {
 };
 
 int fullscreen_data = 0;
+int pixel_perfect_data = 0;
 SliderData music_volume_data = {.min = 0.0, .max = MIX_MAX_VOLUME};
 SliderData sfx_volume_data = {.min = 0.0, .max = MIX_MAX_VOLUME};
 int mute_data = 0;
 int lang_data = 0, prev_lang_data = 0;
 char* language_list[] = {"English (United States)", "简体中文", NULL};
+// the page listing `input_system.bindings` is shown instead of the settings
+int binding_page = 0;
+InputAction binding_action;
+char* binding_text_ids[INPUT_ACTION_COUNT] = {
+    "setting_scene.move_left", "setting_scene.move_right",
+    "setting_scene.jump", "setting_scene.attack"
+};
 
 #if defined(__PSP__)
 SettingItem settings_array[] = {
@@ -85,6 +97,9 @@ SettingItem settings_array[] = {
     {SETTING_TYPE_OPTION,
      "setting_scene.fullscreen",
      {.option = &fullscreen_data}},
+    {SETTING_TYPE_OPTION,
+     "setting_scene.pixel_perfect",
+     {.option = &pixel_perfect_data}},
     {SETTING_TYPE_SUBTITLE, "setting_scene.sound"},
     {SETTING_TYPE_SLIDER,
      "setting_scene.music_volume",
@@ -103,8 +118,10 @@ SettingItem settings_array[] = {
 #endif
 
 void SettingSceneInit() {
+    binding_page = 0;
 #if !defined(__PSP__) && !defined(__vita__)
     fullscreen_data = game_setting.fullscreen;
+    pixel_perfect_data = game_setting.pixel_perfect;
 #endif
 #if !defined(__PSP__)
     if (SDL_strcmp(game_setting.language, "zh_cn") == 0) {
@@ -125,6 +142,71 @@ void SettingSceneInit() {
 
 void SettingSceneFree() {}
 
+char* GetBindingName(InputAction action) {
+    if (game_app.status == GAMESTATUS_KEY_BINDING && binding_action == action) {
+        return GetTransaltionText("setting_scene.press_a_key");
+    }
+    const char* key = SDL_GetKeyName(input_system.bindings[action].key);
+    const char* button = SDL_GameControllerGetStringForButton(
+        input_system.bindings[action].button
+    );
+    if (!game_app.joystick.available || !button) {
+        return (char*)key;
+    } else if (!key[0]) {
+        return (char*)button;
+    }
+    // both bindings work at once, so both are shown
+    static char names[INPUT_ACTION_COUNT][64];
+    snprintf(names[action], sizeof(names[action]), "%s / %s", key, button);
+    return names[action];
+}
+
+/*
+  Draw one row per action. Clicking a binding waits for the next key or
+  controller button, see `SettingSceneOnKeyDown`.
+*/
+void DrawBindingPage(int win_w, int win_h, float space, int char_h) {
+    int widget_y =
+        (win_h - (space * (INPUT_ACTION_COUNT + 1) - (space - 1)) * char_h) /
+        2;
+    WidgetBegin();
+    int action_clicked = -1, back_clicked = 0;
+    for (int i = 0; i < INPUT_ACTION_COUNT; ++i) {
+        int text_w, text_h;
+        MeasureTextSize(
+            GetTransaltionText(binding_text_ids[i]), &text_w, &text_h
+        );
+        if (WidgetButton(win_w / 2.0 + 10, widget_y, GetBindingName(i), 0)) {
+            action_clicked = i;
+        }
+        SetFontAnchor(TEXT_ANCHOR_X_RIGHT | TEXT_ANCHOR_Y_TOP);
+        SetFontColor(0, 0, 0, WidgetIsHovering() ? 128 : 255);
+        DrawText(
+            win_w / 2.0 - 10, widget_y, GetTransaltionText(binding_text_ids[i])
+        );
+        widget_y += text_h * space;
+    }
+    int text_w, text_h;
+    CalcButtonTextSize(
+        GetTransaltionText("setting_scene.back"), &text_w, &text_h
+    );
+    if (WidgetButton(
+            (win_w - text_w) / 2.0, widget_y,
+            GetTransaltionText("setting_scene.back"), 0
+        )) {
+        back_clicked = 1;
+    }
+    WidgetEnd();
+    SetFontAnchor(TEXT_ANCHOR_X_LEFT | TEXT_ANCHOR_Y_TOP);
+    if (action_clicked >= 0) {
+        binding_action = action_clicked;
+        game_app.status = GAMESTATUS_KEY_BINDING;
+    } else if (back_clicked) {
+        binding_page = 0;
+        ClearWidgets();
+    }
+}
+
 void SettingSceneTick(float dt) {
     int win_w, win_h;
     SDL_GetWindowSize(game_app.window, &win_w, &win_h);
@@ -174,6 +256,10 @@ void SettingSceneTick(float dt) {
     int slider_w = win_w / 4 + 100;
 #endif
     DrawBackground(dt);
+    if (binding_page) {
+        DrawBindingPage(win_w, win_h, space, char_h);
+        return;
+    }
     WidgetBegin();
     int button_clicked = -1;
     for (int i = 0; i < SDL_arraysize(settings_array); ++i) {
@@ -260,8 +346,13 @@ void SettingSceneTick(float dt) {
     }
     WidgetEnd();
     SetFontAnchor(TEXT_ANCHOR_X_LEFT | TEXT_ANCHOR_Y_TOP);
-    if (button_clicked == 1) {
+    if (button_clicked == 0) {
+        binding_page = 1;
+        ClearWidgets();
+    } else if (button_clicked == 1) {
+        ResetInputBindings();
         fullscreen_data = 0;
+        pixel_perfect_data = 0;
         music_volume_data.now = 64.0;
         sfx_volume_data.now = 64.0;
 #if defined(__PSP__) || defined(__vita__)
@@ -309,6 +400,10 @@ void SettingSceneTick(float dt) {
         SDL_SetWindowFullscreen(game_app.window, fullscreen_data);
     }
     game_setting.fullscreen = fullscreen_data;
+    if (game_setting.pixel_perfect != pixel_perfect_data) {
+        SetFixedRenderView(pixel_perfect_data);
+    }
+    game_setting.pixel_perfect = pixel_perfect_data;
     if (game_setting.music_volume != (int)music_volume_data.now &&
         game_app.window_focused) {
         Mix_Volume(MUSIC_CHANNEL, (int)music_volume_data.now);
@@ -324,9 +419,22 @@ void SettingSceneTick(float dt) {
 }
 
 void SettingSceneOnKeyDown(SDL_KeyCode key) {
+    if (game_app.status == GAMESTATUS_KEY_BINDING) {
+        // escape cancels the binding
+        if (key != SDLK_ESCAPE) {
+            input_system.bindings[binding_action].key = key;
+        }
+        game_app.status = GAMESTATUS_NORMAL;
+        return;
+    }
     switch (key) {
     case SDLK_ESCAPE:
-        BackToPrevScene();
+        if (binding_page) {
+            binding_page = 0;
+            ClearWidgets();
+        } else {
+            BackToPrevScene();
+        }
         break;
     default:
         break;
@@ -334,7 +442,20 @@ void SettingSceneOnKeyDown(SDL_KeyCode key) {
 }
 
 void SettingSceneOnControllerButtonDown(int button) {
+    if (game_app.status == GAMESTATUS_KEY_BINDING) {
+        // start cancels the binding
+        if (button != SDL_CONTROLLER_BUTTON_START) {
+            input_system.bindings[binding_action].button = button;
+        }
+        game_app.status = GAMESTATUS_NORMAL;
+        return;
+    }
     if (button == SDL_CONTROLLER_BUTTON_B) {
-        BackToPrevScene();
+        if (binding_page) {
+            binding_page = 0;
+            ClearWidgets();
+        } else {
+            BackToPrevScene();
+        }
     }
 }
@@ -30,7 +30,10 @@
 extern GameApp game_app;
 
 Scene start_scene = {
-    .init = StartSceneInit, .free = StartSceneFree, .tick = StartSceneTick
+    .frame_rate = 30,
+    .init = StartSceneInit,
+    .free = StartSceneFree,
+    .tick = StartSceneTick
 };
 BitmapTextStyle title_text_style = {
     1.0, 2, 4, TEXT_ALIGN_CENTER, TEXT_ANCHOR_X_CENTER | TEXT_ANCHOR_Y_CENTER
@@ -22,6 +22,7 @@
 
 #include "world.h"
 #include "../global.h"
+#include "../input.h"
 #include "../map.h"
 #include "background.h"
 
@@ -31,20 +32,67 @@ Scene world_scene = {
     .init = WorldSceneInit,
     .tick = WorldSceneTick,
     .free = WorldSceneFree,
-    .event_handler = WorldSceneHandleEvent,
     .on_key_down = WorldSceneOnKeyDown,
     .on_cbutton_down = WorldSceneOnControllerButtonDown
 };
 
 Map* map;
+// simulation time which has not been stepped yet
+float sim_accumulator = 0;
 
 void WorldSceneInit() {
     map = LoadMap("maps/start.tmx");
+    sim_accumulator = 0;
+    ResetInput();
+}
+
+/*
+  Advance the simulation of `world` by one `SIMULATION_STEP`, after the input
+  of the step has been read. If `profile` is not `NULL`, the time spent in
+  every phase is added to it.
+*/
+void StepWorld(Map* world, WorldProfile* profile) {
+    EntityStore* store = world->entities;
+    Uint64 t0 = SDL_GetPerformanceCounter();
+    UpdateEntityActivity(store);
+    StepEntityPhysics(store, SIMULATION_STEP);
+    Uint64 t1 = SDL_GetPerformanceCounter();
+    TickEntityLogic(store, SIMULATION_STEP);
+    Uint64 t2 = SDL_GetPerformanceCounter();
+    UpdateEntityAnimations(store, SIMULATION_STEP);
+    Uint64 t3 = SDL_GetPerformanceCounter();
+    ApplyEntityCommands(store);
+    FlushRemovedEntities(store);
+    Uint64 t4 = SDL_GetPerformanceCounter();
+    UpdateParticles(world->particles, SIMULATION_STEP);
+    Uint64 t5 = SDL_GetPerformanceCounter();
+    if (profile) {
+        profile->physics += t1 - t0;
+        profile->logic += t2 - t1;
+        profile->animation += t3 - t2;
+        profile->cleanup += t4 - t3;
+        profile->particles += t5 - t4;
+    }
+}
+
+/*
+  Place the entities `alpha` of a step after the last one and let the camera
+  follow the focus. Headless mode runs it too, as the game does every frame.
+*/
+void UpdateWorldView(Map* world, float alpha) {
+    InterpolateEntityStore(world->entities, alpha);
+    UpdateMapCamera(world);
 }
 
 void WorldSceneTick(float dt) {
     DrawBackground(dt);
-    TickEntityList(map->entity_list, dt);
+    sim_accumulator += SDL_min(dt, MAX_SIMULATION_FRAME_TIME);
+    while (sim_accumulator >= SIMULATION_STEP) {
+        UpdateInput();
+        StepWorld(map, NULL);
+        sim_accumulator -= SIMULATION_STEP;
+    }
+    UpdateWorldView(map, sim_accumulator / SIMULATION_STEP);
     DrawMapLayer(map, TILEMAP_LAYERGROUP_BACK);
     DrawMapLayer(map, TILEMAP_LAYERGROUP_MIDDLE);
 }
@@ -53,10 +101,6 @@ void WorldSceneFree() {
     FreeMap(map);
 }
 
-void WorldSceneHandleEvent(SDL_Event* event) {
-    HandleEntityEvent(map->entity_list, event);
-}
-
 void WorldSceneOnKeyDown(SDL_KeyCode key) {
     switch (key) {
     case SDLK_ESCAPE:
@@ -25,12 +25,34 @@
 
 #include "scene.h"
 
+#if !defined(TH_SIMULATION_RATE)
+    #define TH_SIMULATION_RATE 120
+#endif
+#define SIMULATION_STEP (1.0f / TH_SIMULATION_RATE)
+// longest frame time fed into the simulation, so that a long frame (such as
+// loading a map) does not make it catch up for seconds
+#define MAX_SIMULATION_FRAME_TIME 0.25f
+
+// time spent in every phase of `StepWorld`, in performance counter ticks
+typedef struct WorldProfile {
+    Uint64 physics;
+    Uint64 logic;
+    Uint64 animation;
+    Uint64 cleanup;
+    Uint64 particles;
+} WorldProfile;
+
+struct Map;
+typedef struct Map Map;
+
 extern Scene world_scene;
 
+void StepWorld(Map* world, WorldProfile* profile);
+void UpdateWorldView(Map* world, float alpha);
+
 void WorldSceneInit();
 void WorldSceneFree();
 void WorldSceneTick(float dt);
-void WorldSceneHandleEvent(SDL_Event* event);
 void WorldSceneOnKeyDown(SDL_KeyCode key);
 void WorldSceneOnControllerButtonDown(int button);
 
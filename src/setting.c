@@ -23,11 +23,13 @@
 /*
   Read and write setting.
 
-  Using `game_setting` to get and set setting.
+  Using `game_setting` to get and set setting. Key bindings live in
+  `input_system.bindings` and are stored here too.
 */
 
 #include "setting.h"
 #include "global.h"
+#include "input.h"
 #include <cjson/cJSON.h>
 #include <stdio.h>
 #include <string.h>
@@ -71,6 +73,11 @@ void InitSetting() {
             game_setting.fullscreen = object->valueint;
         }
     }
+    if ((object = cJSON_GetObjectItem(setting_json, "pixel_perfect")) != NULL) {
+        if (cJSON_IsBool(object)) {
+            game_setting.pixel_perfect = object->valueint;
+        }
+    }
 #endif
 #if !defined(__PSP__)
     if ((object = cJSON_GetObjectItem(setting_json, "language")) != NULL) {
@@ -107,6 +114,32 @@ void InitSetting() {
         }
     }
 #endif
+    if ((object = cJSON_GetObjectItem(setting_json, "key_bindings")) != NULL) {
+        for (int i = 0; i < INPUT_ACTION_COUNT; ++i) {
+            cJSON* item = cJSON_GetObjectItem(object, input_action_names[i]);
+            if (!cJSON_IsString(item)) {
+                continue;
+            }
+            SDL_Keycode key = SDL_GetKeyFromName(item->valuestring);
+            if (key != SDLK_UNKNOWN) {
+                input_system.bindings[i].key = key;
+            }
+        }
+    }
+    if ((object = cJSON_GetObjectItem(setting_json, "controller_bindings")) !=
+        NULL) {
+        for (int i = 0; i < INPUT_ACTION_COUNT; ++i) {
+            cJSON* item = cJSON_GetObjectItem(object, input_action_names[i]);
+            if (!cJSON_IsString(item)) {
+                continue;
+            }
+            SDL_GameControllerButton button =
+                SDL_GameControllerGetButtonFromString(item->valuestring);
+            if (button != SDL_CONTROLLER_BUTTON_INVALID) {
+                input_system.bindings[i].button = button;
+            }
+        }
+    }
     cJSON_Delete(setting_json);
     free(data);
     free(setting_file);
@@ -135,6 +168,9 @@ void SaveSetting() {
     cJSON* setting_json = cJSON_CreateObject();
 #if !defined(__PSP__) && !defined(__vita__)
     cJSON_AddBoolToObject(setting_json, "fullscreen", game_setting.fullscreen);
+    cJSON_AddBoolToObject(
+        setting_json, "pixel_perfect", game_setting.pixel_perfect
+    );
 #endif
 #if !defined(__PSP__)
     cJSON_AddStringToObject(setting_json, "language", game_setting.language);
@@ -153,6 +189,21 @@ void SaveSetting() {
         setting_json, "mute_when_unfocused", game_setting.mute_when_unfocused
     );
 #endif
+    cJSON* key_bindings = cJSON_AddObjectToObject(setting_json, "key_bindings");
+    cJSON* controller_bindings =
+        cJSON_AddObjectToObject(setting_json, "controller_bindings");
+    for (int i = 0; i < INPUT_ACTION_COUNT; ++i) {
+        cJSON_AddStringToObject(
+            key_bindings, input_action_names[i],
+            SDL_GetKeyName(input_system.bindings[i].key)
+        );
+        cJSON_AddStringToObject(
+            controller_bindings, input_action_names[i],
+            SDL_GameControllerGetStringForButton(
+                input_system.bindings[i].button
+            )
+        );
+    }
     size_t len = 128;
     char* json_string = (char*)calloc(len, sizeof(char));
     while (!cJSON_PrintPreallocated(setting_json, json_string, len, 0)) {
@@ -26,6 +26,7 @@
 typedef struct Setting {
 #if !defined(__PSP__) && !defined(__vita__)
     int fullscreen;
+    int pixel_perfect;
 #endif
 #if !defined(__PSP__)
     char* language;
@@ -25,13 +25,12 @@
 */
 
 #include "../../global.h"
+#include "../../image/image.h"
 #include "../../resource/loader.h"
 #include "text.h"
 #include <assert.h>
 #include <stdio.h>
 
-extern GameApp game_app;
-
 SDL_Texture* big_text_texture = NULL;
 SDL_Texture* small_text_texture = NULL;
 SDL_Texture* input_prompt_texture = NULL;
@@ -145,8 +144,9 @@ void DrawBigBitmapText(
             text_dst.x += BIG_TEXT_WIDTH * style->size;
             continue;
         }
-        SDL_RenderCopyF(
-            game_app.renderer, big_text_texture, &text_src, &text_dst
+        SubmitTexture(
+            big_text_texture, &text_src, &text_dst,
+            (SDL_Color){255, 255, 255, 255}
         );
         text_dst.x += BIG_TEXT_WIDTH * style->size + style->char_space;
     }
@@ -195,9 +195,6 @@ void DrawSmallBitmapText(
 #if defined(TH_FALLBACK_TO_BITMAP_FONT)
     y += 0.25 * style->size;
 #endif
-    SDL_SetTextureColorMod(
-        small_text_texture, style->color.r, style->color.g, style->color.b
-    );
     va_list args;
     va_start(args, format);
     char* str;
@@ -247,30 +244,18 @@ void DrawSmallBitmapText(
             text_src.x = (str[i] - ' ') % 16 * SMALL_TEXT_WIDTH;
             text_src.y = (str[i] - ' ') / 16 * SMALL_TEXT_HEIGHT;
             if (style->has_shadow) {
-                SDL_SetTextureColorMod(
-                    small_text_texture, style->shadow_color.r,
-                    style->shadow_color.g, style->shadow_color.b
-                );
-                SDL_SetTextureAlphaMod(
-                    small_text_texture, style->shadow_color.a
-                );
                 SDL_FRect shadow_dst = {
                     text_dst.x + style->shadow_offset.x * style->size,
                     text_dst.y + style->shadow_offset.y * style->size,
                     text_dst.w, text_dst.h
                 };
-                SDL_RenderCopyF(
-                    game_app.renderer, small_text_texture, &text_src,
-                    &shadow_dst
+                SubmitTexture(
+                    small_text_texture, &text_src, &shadow_dst,
+                    style->shadow_color
                 );
             }
-            SDL_SetTextureColorMod(
-                small_text_texture, style->color.r, style->color.g,
-                style->color.b
-            );
-            SDL_SetTextureAlphaMod(small_text_texture, style->color.a);
-            SDL_RenderCopyF(
-                game_app.renderer, small_text_texture, &text_src, &text_dst
+            SubmitTexture(
+                small_text_texture, &text_src, &text_dst, style->color
             );
         }
         text_dst.x += style->size + style->char_space;
@@ -283,10 +268,7 @@ void DrawBitmapIcon(float x, float y, int size, SDL_Color color, IconID id) {
         (id + 96) % 16 * SMALL_TEXT_WIDTH, (id + 96) / 16 * SMALL_TEXT_HEIGHT,
         SMALL_TEXT_WIDTH, SMALL_TEXT_HEIGHT
     };
-    SDL_SetTextureColorMod(small_text_texture, color.r, color.g, color.b);
-    SDL_SetTextureAlphaMod(small_text_texture, color.a);
-    SDL_RenderCopy(
-        game_app.renderer, small_text_texture, &icon_src,
-        &(SDL_Rect){x, y, size, size}
+    SubmitTexture(
+        small_text_texture, &icon_src, &(SDL_FRect){x, y, size, size}, color
     );
 }
@@ -41,6 +41,17 @@
 #define SMALL_TEXT_WIDTH 8
 #define SMALL_TEXT_HEIGHT 8
 
+// side of the texture TTF glyphs are cached in
+#if defined(__vita__)
+    #define GLYPH_ATLAS_SIZE 1024
+#else
+    #define GLYPH_ATLAS_SIZE 2048
+#endif
+// slots of the glyph table, a power of two
+#define GLYPH_TABLE_SIZE 4096
+// fonts of different faces, sizes or styles kept open at once
+#define FONT_INSTANCE_CACHE_SIZE 8
+
 typedef struct BitmapTextStyle {
     float size;
     int char_space;
@@ -71,6 +82,19 @@ typedef enum FontFaceIndex {
     FONTFACE_NOTOCJK_HK
 } FontFaceIndex;
 
+/*
+  A glyph cached in the atlas, looked up by its face, style, size and
+  codepoint packed into `key`. `rect` is the cell SDL_ttf renders for it,
+  from the top of the line, and the pen is `offset` pixels from its left
+  edge.
+*/
+typedef struct Glyph {
+    Uint64 key;
+    SDL_Rect rect;
+    int offset;
+    int advance;
+} Glyph;
+
 typedef struct FontConfig {
     int align;
     int anchor;
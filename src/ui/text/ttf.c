@@ -23,12 +23,18 @@
 /*
    Draw TTF font. If defined TH_FALLBACK_TO_BITMAP_FONT, it will fallback to
    draw bitmap fonts.
+
+   Glyphs are rendered by SDL_ttf once and cached in an atlas, text is laid
+   out here and drawn as quads of the atlas.
 */
 
 #include "../../global.h"
+#include "../../image/image.h"
 #include "text.h"
 #include <SDL_ttf.h>
+#include <limits.h>
 #include <stdarg.h>
+#include <string.h>
 
 #if !defined(TH_FALLBACK_TO_BITMAP_FONT)
     #include "../../resource/respack.h"
@@ -36,14 +42,323 @@
 
 extern GameApp game_app;
 
+/*
+  An opened font of one face, size and style. SDL_ttf caches glyphs per
+  font, and changing the size or style of a font drops them.
+*/
+typedef struct FontInstance {
+    TTF_Font* font;
+    long index;
+    int size;
+    int style;
+    Uint32 last_used;
+} FontInstance;
+
+// every instance reads the same font file in `mem`, `font` is the one of
+// the current face, size and style
 struct {
     void* mem;
     size_t mem_size;
-    SDL_RWops* src;
     TTF_Font* font;
+    long index;
+    FontInstance instances[FONT_INSTANCE_CACHE_SIZE];
+    Uint32 use_clock;
 } font;
 FontConfig font_config;
-int max_wrapped_width = 512;
+// glyphs of every face, style and size drawn so far, packed into rows of the
+// atlas
+struct {
+    SDL_Texture* atlas;
+    int atlas_size;
+    int row_x;
+    int row_y;
+    int row_h;
+    int count;
+    Glyph table[GLYPH_TABLE_SIZE];
+} glyph_cache;
+
+#if !defined(TH_FALLBACK_TO_BITMAP_FONT)
+/*
+  Forget every cached glyph and start a new atlas. The old one may still be
+  used by text submitted this frame, so it is destroyed after the flush.
+*/
+void ResetGlyphCache() {
+    if (glyph_cache.atlas != NULL) {
+        DestroyTextureAfterFlush(glyph_cache.atlas);
+    }
+    glyph_cache.atlas = SDL_CreateTexture(
+        game_app.renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+        glyph_cache.atlas_size, glyph_cache.atlas_size
+    );
+    SDL_SetTextureBlendMode(glyph_cache.atlas, SDL_BLENDMODE_BLEND);
+    glyph_cache.row_x = 0;
+    glyph_cache.row_y = 0;
+    glyph_cache.row_h = 0;
+    glyph_cache.count = 0;
+    memset(glyph_cache.table, 0, sizeof(glyph_cache.table));
+}
+
+/*
+  Copy a glyph rendered by SDL_ttf into the atlas. Return 0 if there is no
+  room left.
+*/
+int PackGlyph(SDL_Surface* surface, SDL_Rect* rect) {
+    if (glyph_cache.atlas == NULL) {
+        return 0;
+    }
+    // glyphs are one pixel apart, so that they never bleed into each other
+    if (glyph_cache.row_x + surface->w > glyph_cache.atlas_size) {
+        glyph_cache.row_x = 0;
+        glyph_cache.row_y += glyph_cache.row_h + 1;
+        glyph_cache.row_h = 0;
+    }
+    if (glyph_cache.row_y + surface->h > glyph_cache.atlas_size) {
+        return 0;
+    }
+    *rect = (SDL_Rect){
+        glyph_cache.row_x, glyph_cache.row_y, surface->w, surface->h
+    };
+    SDL_UpdateTexture(glyph_cache.atlas, rect, surface->pixels, surface->pitch);
+    glyph_cache.row_x += surface->w + 1;
+    glyph_cache.row_h = SDL_max(glyph_cache.row_h, surface->h);
+    return 1;
+}
+
+/*
+  Find `ch` of the current face, style and size, rendering it into the atlas
+  the first time it is drawn. A full atlas is started again.
+*/
+Glyph* GetGlyph(Uint32 ch) {
+    Uint64 key = (Uint64)(font.index & 0xff) << 56 |
+                 (Uint64)(font_config.style & 0xff) << 48 |
+                 (Uint64)(font_config.size & 0xffffff) << 24 | ch;
+    Uint32 mask = GLYPH_TABLE_SIZE - 1;
+    Uint32 slot = (Uint32)((key * 0x9e3779b97f4a7c15ull) >> 32) & mask;
+    while (glyph_cache.table[slot].key != 0) {
+        if (glyph_cache.table[slot].key == key) {
+            return &glyph_cache.table[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    if (glyph_cache.count >= GLYPH_TABLE_SIZE / 4 * 3) {
+        ResetGlyphCache();
+        return GetGlyph(ch);
+    }
+    Glyph glyph = {.key = key};
+    int minx;
+    if (TTF_GlyphMetrics32(
+            font.font, ch, &minx, NULL, NULL, NULL, &glyph.advance
+        ) == 0) {
+        glyph.offset = minx < 0 ? -minx : 0;
+    }
+    SDL_Surface* surface = TTF_RenderGlyph32_Blended(
+        font.font, ch, (SDL_Color){255, 255, 255, 255}
+    );
+    if (surface) {
+        int is_packed = PackGlyph(surface, &glyph.rect);
+        SDL_FreeSurface(surface);
+        if (!is_packed && glyph_cache.count > 0) {
+            ResetGlyphCache();
+            return GetGlyph(ch);
+        }
+    }
+    glyph_cache.table[slot] = glyph;
+    ++glyph_cache.count;
+    return &glyph_cache.table[slot];
+}
+
+/*
+  Decode the codepoint at `*str` and move past it. A broken sequence is read
+  as U+FFFD, one byte at a time.
+*/
+Uint32 NextCodepoint(const char** str) {
+    const unsigned char* s = (const unsigned char*)*str;
+    Uint32 ch;
+    int len;
+    if (s[0] < 0x80) {
+        ch = s[0];
+        len = 1;
+    } else if ((s[0] & 0xe0) == 0xc0) {
+        ch = s[0] & 0x1f;
+        len = 2;
+    } else if ((s[0] & 0xf0) == 0xe0) {
+        ch = s[0] & 0x0f;
+        len = 3;
+    } else if ((s[0] & 0xf8) == 0xf0) {
+        ch = s[0] & 0x07;
+        len = 4;
+    } else {
+        *str += 1;
+        return 0xfffd;
+    }
+    for (int i = 1; i < len; ++i) {
+        if ((s[i] & 0xc0) != 0x80) {
+            *str += 1;
+            return 0xfffd;
+        }
+        ch = ch << 6 | (s[i] & 0x3f);
+    }
+    *str += len;
+    return ch;
+}
+
+int GetKerning(Uint32 prev, Uint32 ch) {
+    return prev ? TTF_GetFontKerningSizeGlyphs32(font.font, prev, ch) : 0;
+}
+
+/*
+  Return how many bytes of `str` fit in a line of `max_width` pixels and set
+  `width` to their width. Lines are broken at the last space which fits, or
+  before the first character which does not fit if there is none, and always
+  at a newline.
+*/
+int LayoutTextLine(const char* str, int max_width, int* width) {
+    const char* p = str;
+    int pen = 0;
+    int break_at = -1, break_width = 0;
+    Uint32 prev = 0;
+    while (*p != '\0' && *p != '\n') {
+        const char* next = p;
+        Uint32 ch = NextCodepoint(&next);
+        int end = pen + GetKerning(prev, ch) + GetGlyph(ch)->advance;
+        if (end > max_width && p != str) {
+            if (break_at >= 0) {
+                *width = break_width;
+                return break_at;
+            }
+            break;
+        }
+        if (ch == ' ') {
+            break_at = p - str;
+            break_width = pen;
+        }
+        pen = end;
+        prev = ch;
+        p = next;
+    }
+    *width = pen;
+    return p - str;
+}
+
+/*
+  Move past a line returned by `LayoutTextLine` and the space or newline it
+  was broken at. Return 0 after the last line.
+*/
+int NextTextLine(const char** str, int len) {
+    *str += len;
+    if (**str == ' ' || **str == '\n') {
+        ++*str;
+    }
+    return **str != '\0';
+}
+
+void MeasureTextBlock(const char* str, int max_width, int* w, int* h) {
+    int lines = 0, block_w = 0, line_w, len;
+    do {
+        len = LayoutTextLine(str, max_width, &line_w);
+        block_w = SDL_max(block_w, line_w);
+        ++lines;
+    } while (NextTextLine(&str, len));
+    if (w) {
+        *w = block_w;
+    }
+    if (h) {
+        *h = TTF_FontHeight(font.font) +
+             (lines - 1) * TTF_FontLineSkip(font.font);
+    }
+}
+
+/*
+  Submit `len` bytes of `str` as one run of quads, with the pen starting at
+  (`x`, `y`) on the top of the line.
+*/
+void DrawTextLine(const char* str, int len, int x, int y) {
+    // every glyph is cached before the quads are submitted, so that the atlas
+    // can not be started again under them
+    int count = 0;
+    for (const char* p = str; p < str + len; ++count) {
+        GetGlyph(NextCodepoint(&p));
+    }
+    if (count == 0 || glyph_cache.atlas == NULL) {
+        return;
+    }
+    SDL_Vertex* vertices = SubmitQuads(glyph_cache.atlas, count);
+    float size = glyph_cache.atlas_size;
+    int pen = x, n = 0;
+    Uint32 prev = 0;
+    for (const char* p = str; p < str + len;) {
+        Uint32 ch = NextCodepoint(&p);
+        Glyph* glyph = GetGlyph(ch);
+        pen += GetKerning(prev, ch);
+        prev = ch;
+        if (glyph->rect.w > 0) {
+            SDL_Rect* rect = &glyph->rect;
+            float x0 = pen - glyph->offset, y0 = y;
+            float x1 = x0 + rect->w, y1 = y0 + rect->h;
+            float u0 = rect->x / size, v0 = rect->y / size;
+            float u1 = (rect->x + rect->w) / size;
+            float v1 = (rect->y + rect->h) / size;
+            SDL_Color color = font_config.color;
+            SDL_Vertex* vertex = &vertices[4 * n++];
+            vertex[0] = (SDL_Vertex){{x0, y0}, color, {u0, v0}};
+            vertex[1] = (SDL_Vertex){{x1, y0}, color, {u1, v0}};
+            vertex[2] = (SDL_Vertex){{x1, y1}, color, {u1, v1}};
+            vertex[3] = (SDL_Vertex){{x0, y1}, color, {u0, v1}};
+        }
+        pen += glyph->advance;
+    }
+    TrimSubmittedQuads(n);
+}
+#endif
+
+#if !defined(TH_FALLBACK_TO_BITMAP_FONT)
+/*
+  Make the instance of the current face, size and style current. It is
+  opened if there is none, in place of the least recently used one, so that
+  switching between a few sizes never throws the glyphs of SDL_ttf away.
+*/
+void SelectFontInstance() {
+    FontInstance* lru = &font.instances[0];
+    ++font.use_clock;
+    for (int i = 0; i < FONT_INSTANCE_CACHE_SIZE; ++i) {
+        FontInstance* instance = &font.instances[i];
+        if (instance->font && instance->index == font.index &&
+            instance->size == font_config.size &&
+            instance->style == font_config.style) {
+            instance->last_used = font.use_clock;
+            font.font = instance->font;
+            return;
+        }
+        if (!instance->font || (lru->font && instance->last_used <
+                                                 lru->last_used)) {
+            lru = instance;
+        }
+    }
+    SDL_RWops* src = SDL_RWFromConstMem(font.mem, font.mem_size);
+    TTF_Font* opened =
+        TTF_OpenFontIndexRW(src, 1, font_config.size, font.index);
+    if (opened == NULL) {
+        SDL_LogError(
+            SDL_LOG_CATEGORY_ERROR, "TTF_OpenFontIndexRW(): %s\n",
+            SDL_GetError()
+        );
+        return;
+    }
+    TTF_SetFontKerning(opened, 1);
+    TTF_SetFontStyle(opened, font_config.style);
+    if (lru->font) {
+        TTF_CloseFont(lru->font);
+    }
+    *lru = (FontInstance){
+        .font = opened,
+        .index = font.index,
+        .size = font_config.size,
+        .style = font_config.style,
+        .last_used = font.use_clock
+    };
+    font.font = opened;
+}
+#endif
 
 void InitTTFText() {
 #if defined(TH_FALLBACK_TO_BITMAP_FONT)
@@ -52,13 +367,18 @@ void InitTTFText() {
     font.mem = GetRespackItem(
         game_app.assets_pack, "fonts/NotoSansMonoCJK.ttc", &font.mem_size
     );
-    font.src = SDL_RWFromMem(font.mem, font.mem_size);
-    font.font = TTF_OpenFontIndexRW(font.src, 1, 32, FONTFACE_NOTOCJK_JP);
+    font.index = FONTFACE_NOTOCJK_JP;
+    font_config.size = 32;
+    SelectFontInstance();
     font_config.color = (SDL_Color){0, 0, 0, 255};
+    glyph_cache.atlas_size = GLYPH_ATLAS_SIZE;
     SDL_RendererInfo info;
-    if (SDL_GetRendererInfo(game_app.renderer, &info) == 0) {
-        max_wrapped_width = info.max_texture_width;
+    if (SDL_GetRendererInfo(game_app.renderer, &info) == 0 &&
+        info.max_texture_width > 0) {
+        glyph_cache.atlas_size =
+            SDL_min(glyph_cache.atlas_size, info.max_texture_width);
     }
+    ResetGlyphCache();
 #endif
 }
 
@@ -66,8 +386,15 @@ void QuitTTFText() {
 #if defined(TH_FALLBACK_TO_BITMAP_FONT)
     return;
 #else
-    TTF_CloseFont(font.font);
+    for (int i = 0; i < FONT_INSTANCE_CACHE_SIZE; ++i) {
+        if (font.instances[i].font) {
+            TTF_CloseFont(font.instances[i].font);
+        }
+    }
     free(font.mem);
+    if (glyph_cache.atlas != NULL) {
+        SDL_DestroyTexture(glyph_cache.atlas);
+    }
 #endif
 }
 
@@ -75,20 +402,13 @@ void ReloadFont(long index) {
 #if defined(TH_FALLBACK_TO_BITMAP_FONT)
     return;
 #else
-    TTF_CloseFont(font.font);
-    font.src = SDL_RWFromMem(font.mem, font.mem_size);
-    font.font = TTF_OpenFontIndexRW(font.src, 1, font_config.size, index);
-    TTF_SetFontKerning(font.font, 1);
-    TTF_SetFontStyle(font.font, font_config.style);
-    TTF_SetFontWrappedAlign(font.font, font_config.align);
+    font.index = index;
+    SelectFontInstance();
 #endif
 }
 
 void SetFontAlign(int align) {
     font_config.align = align;
-#if !defined(TH_FALLBACK_TO_BITMAP_FONT)
-    TTF_SetFontWrappedAlign(font.font, align);
-#endif
 }
 
 void SetFontAnchor(int anchor) {
@@ -98,14 +418,14 @@ void SetFontAnchor(int anchor) {
 void SetFontSize(int size) {
     font_config.size = size;
 #if !defined(TH_FALLBACK_TO_BITMAP_FONT)
-    TTF_SetFontSize(font.font, size);
+    SelectFontInstance();
 #endif
 }
 
 void SetFontStyle(int style) {
     font_config.style = style;
 #if !defined(TH_FALLBACK_TO_BITMAP_FONT)
-    TTF_SetFontStyle(font.font, style);
+    SelectFontInstance();
 #endif
 }
 
@@ -132,7 +452,8 @@ int MeasureTextSize(char* str, int* w, int* h) {
     }
     return 1;
 #else
-    return TTF_SizeUTF8(font.font, str, w, h);
+    MeasureTextBlock(str, INT_MAX, w, h);
+    return 0;
 #endif
 }
 
@@ -166,11 +487,8 @@ void DrawTextWrappedV(int x, int y, int max_width, char* format, va_list args) {
     };
     DrawSmallBitmapText(x, y, &style, str);
 #else
-    if (max_width > max_wrapped_width) {
-        max_width = max_wrapped_width;
-    }
     int text_w, text_h;
-    MeasureTextSize(str, &text_w, &text_h);
+    MeasureTextBlock(str, max_width, &text_w, &text_h);
     if (font_config.anchor & TEXT_ANCHOR_X_CENTER) {
         x -= text_w / 2;
     } else if (font_config.anchor & TEXT_ANCHOR_X_RIGHT) {
@@ -181,17 +499,19 @@ void DrawTextWrappedV(int x, int y, int max_width, char* format, va_list args) {
     } else if (font_config.anchor & TEXT_ANCHOR_Y_BOTTOM) {
         y -= text_h;
     }
-    SDL_Surface* surface = TTF_RenderUTF8_Blended_Wrapped(
-        font.font, str, font_config.color, max_width
-    );
-    SDL_Texture* texture =
-        SDL_CreateTextureFromSurface(game_app.renderer, surface);
-    SDL_RenderCopy(
-        game_app.renderer, texture, NULL,
-        &(SDL_Rect){x, y, surface->w, surface->h}
-    );
-    SDL_FreeSurface(surface);
-    SDL_DestroyTexture(texture);
+    const char* line = str;
+    int line_w, len;
+    do {
+        len = LayoutTextLine(line, max_width, &line_w);
+        int line_x = x;
+        if (font_config.align == TTF_WRAPPED_ALIGN_CENTER) {
+            line_x += (text_w - line_w) / 2;
+        } else if (font_config.align == TTF_WRAPPED_ALIGN_RIGHT) {
+            line_x += text_w - line_w;
+        }
+        DrawTextLine(line, len, line_x, y);
+        y += TTF_FontLineSkip(font.font);
+    } while (NextTextLine(&line, len));
 #endif
     free(str);
 }
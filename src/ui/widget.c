@@ -30,6 +30,7 @@
 
 #include "widget.h"
 #include "../global.h"
+#include "../image/image.h"
 #include "../resource/loader.h"
 #include "frametimer.h"
 #include "text/text.h"
@@ -337,9 +338,9 @@ int WidgetOption(float x, float y, int size, int* data) {
     SDL_FRect button_dst = {
         x - 0.5 * size, y - 3.0 / 8 * size, size * 2, size * 2
     };
-    SDL_RenderCopyF(
-        game_app.renderer, button_texture, &(SDL_Rect){0, 0, 14, 14},
-        &button_dst
+    SubmitTexture(
+        button_texture, &(SDL_Rect){0, 0, 14, 14}, &button_dst,
+        (SDL_Color){255, 255, 255, 255}
     );
     if (ctx.should_update_widgets) {
         AppendWidget(&button_dst);
@@ -377,17 +378,18 @@ int WidgetSlider(float x, float y, float w, float h, SliderData* data) {
         {x, y, h, h}, {x + h - 1, y, w - 2 * h + 2, h}, {x + w - h, y, h, h}
     };
     for (int i = 0; i < 3; ++i) {
-        SDL_RenderCopyF(
-            game_app.renderer, slider_texture, &slider_src[i], &slider_dst[i]
+        SubmitTexture(
+            slider_texture, &slider_src[i], &slider_dst[i],
+            (SDL_Color){255, 255, 255, 255}
         );
     }
     SDL_FRect button_dst = {
         x + w * (data->now - data->min) / (data->max - data->min) - 7 * h / 12,
         y - 5 * h / 12, 7 * h / 6, 11 * h / 6
     };
-    SDL_RenderCopyF(
-        game_app.renderer, slider_texture, &(SDL_Rect){15, 1, 7, 11},
-        &button_dst
+    SubmitTexture(
+        slider_texture, &(SDL_Rect){15, 1, 7, 11}, &button_dst,
+        (SDL_Color){255, 255, 255, 255}
     );
     // handle events
     SDL_FRect box = {x, y, w, h};
@@ -447,9 +449,8 @@ int WidgetSlider(float x, float y, float w, float h, SliderData* data) {
 void WidgetEnd() {
     ctx.should_update_widgets = 0;
 #if !defined(NDEBUG)
-    SDL_SetRenderDrawColor(game_app.renderer, 255, 0, 0, 255);
     for (size_t i = 0; i < ctx.widget_list.len; ++i) {
-        SDL_RenderDrawRectF(game_app.renderer, &ctx.widget_list.data[i]);
+        SubmitDrawRect(&ctx.widget_list.data[i], (SDL_Color){255, 0, 0, 255});
     }
 #endif
 }
@@ -0,0 +1,133 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+
+#include "entities/base.h"
+#include "entities/broadphase.h"
+#include "test.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ENTITY_COUNT 300
+#define QUERY_COUNT 500
+
+float RandomFloat(float min, float max) {
+    return min + (max - min) * (float)rand() / RAND_MAX;
+}
+
+SDL_FRect RandomRect(float extent) {
+    return (SDL_FRect){
+        RandomFloat(-extent, extent), RandomFloat(-extent, extent),
+        RandomFloat(0, 200), RandomFloat(0, 200)
+    };
+}
+
+int Overlaps(SDL_FRect* a, SDL_FRect* b) {
+    return a->x < b->x + b->w && b->x < a->x + a->w && a->y < b->y + b->h &&
+           b->y < a->y + a->h;
+}
+
+/*
+  Place the entities at random in a square of `2 * extent` pixels, with a few
+  of them far away so that the grid cells grow.
+*/
+void ScatterEntities(EntityStore* store, float extent) {
+    for (int i = 0; i < store->count; ++i) {
+        float spread = i % 50 == 0 ? 40 * extent : extent;
+        store->pos[i] = (Vector2f){
+            RandomFloat(-spread, spread), RandomFloat(-spread, spread)
+        };
+        store->bbox[i] =
+            (SDL_FRect){0, 0, RandomFloat(1, 48), RandomFloat(1, 48)};
+        Entity* entity = &store->data[i];
+        entity->is_attacking = rand() % 4 == 0;
+        entity->hitbox = (SDL_FRect){
+            RandomFloat(-32, 32), RandomFloat(0, 48), RandomFloat(1, 64),
+            RandomFloat(1, 64)
+        };
+    }
+    store->grid.is_dirty = 1;
+}
+
+void TestQueryEntitiesInRect(EntityStore* store, float extent) {
+    Uint8 found[ENTITY_COUNT];
+    for (int q = 0; q < QUERY_COUNT; ++q) {
+        SDL_FRect rect = RandomRect(extent);
+        int count;
+        int* indices = QueryEntitiesInRect(store, &rect, &count);
+        memset(found, 0, sizeof(found));
+        for (int i = 0; i < count; ++i) {
+            // every entity is reported at most once
+            CHECK(!found[indices[i]]);
+            found[indices[i]] = 1;
+        }
+        for (int i = 0; i < store->count; ++i) {
+            SDL_FRect box = GetEntityBox(store, i);
+            CHECK(found[i] == Overlaps(&box, &rect));
+        }
+    }
+}
+
+int CountHits(EntityHit* hits, int count, int attacker, int target) {
+    int n = 0;
+    for (int i = 0; i < count; ++i) {
+        n += hits[i].attacker == attacker && hits[i].target == target;
+    }
+    return n;
+}
+
+void TestQueryEntityHits(EntityStore* store) {
+    int count;
+    EntityHit* hits = QueryEntityHits(store, &count);
+    int expected = 0;
+    for (int i = 0; i < store->count; ++i) {
+        if (!store->data[i].is_attacking) {
+            continue;
+        }
+        SDL_FRect hitbox = GetEntityHitbox(store, i);
+        for (int j = 0; j < store->count; ++j) {
+            SDL_FRect box = GetEntityBox(store, j);
+            if (j != i && Overlaps(&hitbox, &box)) {
+                CHECK(CountHits(hits, count, i, j) == 1);
+                ++expected;
+            }
+        }
+    }
+    CHECK(count == expected);
+}
+
+int main(int argc, char* argv[]) {
+    srand(1);
+    EntityStore* store = CreateEntityStore();
+    for (int i = 0; i < ENTITY_COUNT; ++i) {
+        AddEntity(store, ENTITY_TYPE_PLAYER, NULL);
+    }
+    // dense and sparse layouts, the grid is built again for each
+    float extents[] = {100, 1000, 20000};
+    for (int i = 0; i < SDL_arraysize(extents); ++i) {
+        ScatterEntities(store, extents[i]);
+        TestQueryEntitiesInRect(store, extents[i] * 1.2f);
+        TestQueryEntityHits(store);
+    }
+    FreeEntityStore(store);
+    return test_failures != 0;
+}
@@ -0,0 +1,79 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "input.h"
+#include "test.h"
+
+void PressKey(SDL_EventType type, SDL_Keycode key) {
+    SDL_Event event = {.type = type};
+    event.key.keysym.sym = key;
+    HandleInputEvent(&event);
+}
+
+/*
+  A tap between two ticks is seen by the next tick only, and a held key is
+  seen until it is released.
+*/
+void TestLatchedPress() {
+    Uint8 jump = INPUT_ACTION_BIT(INPUT_ACTION_JUMP);
+    Uint8 right = INPUT_ACTION_BIT(INPUT_ACTION_RIGHT);
+    ResetInput();
+    PressKey(SDL_KEYDOWN, SDLK_x);
+    PressKey(SDL_KEYUP, SDLK_x);
+    PressKey(SDL_KEYDOWN, SDLK_RIGHT);
+    UpdateInput();
+    CHECK(input_system.state.actions == (jump | right));
+    CHECK(input_system.state.pressed == (jump | right));
+    CHECK(input_system.state.move_x > 0);
+    UpdateInput();
+    CHECK(input_system.state.actions == right);
+    CHECK(input_system.state.pressed == 0);
+    PressKey(SDL_KEYUP, SDLK_RIGHT);
+    UpdateInput();
+    CHECK(input_system.state.actions == 0);
+}
+
+/*
+  The world scene resets the input when it starts, so that the controller
+  button which clicked "Start" in the menu does not make the player jump.
+*/
+void TestResetBetweenScenes() {
+    ResetInput();
+    PressKey(SDL_KEYDOWN, SDLK_x);
+    PressKey(SDL_KEYDOWN, SDLK_LEFT);
+    ResetInput();
+    UpdateInput();
+    CHECK(input_system.state.actions == 0);
+    CHECK(input_system.state.pressed == 0);
+    CHECK(input_system.state.move_x == 0);
+    // releasing a key which was held through the reset changes nothing
+    PressKey(SDL_KEYUP, SDLK_LEFT);
+    UpdateInput();
+    CHECK(input_system.state.actions == 0);
+}
+
+int main(int argc, char* argv[]) {
+    ResetInputBindings();
+    TestLatchedPress();
+    TestResetBetweenScenes();
+    return test_failures != 0;
+}
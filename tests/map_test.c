@@ -0,0 +1,214 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "map.h"
+#include "test.h"
+#include <string.h>
+
+#define MAP_W 24
+#define MAP_H 3
+#define TILE_SIZE 32
+
+#define GROUND 1
+#define SPIKES 2
+#define GRASS 3
+
+// Tiled keeps the flips of a tile in the top bits of its gid
+#define FLIP_VERTICAL 0x40000000
+#define FLIP_DIAGONAL 0x20000000
+
+extern TileMask* terrains_mask;
+
+/*
+  Pixel masks of the three tiles: ground fills the lower half, spikes stand on
+  it in rows 8 to 15 and grass covers the left half of rows 12 to 15.
+*/
+void CreateTestMask(TileMask* mask, uint64_t* bits, SDL_Rect* bounds) {
+    *mask = (TileMask){TILE_SIZE, TILE_SIZE, 3, 1, bits, bounds};
+    memset(bits, 0, 3 * TILE_SIZE * sizeof(uint64_t));
+    for (int y = 16; y < 32; ++y) {
+        bits[(GROUND - 1) * TILE_SIZE + y] = 0xffffffff;
+    }
+    for (int y = 8; y < 16; ++y) {
+        bits[(SPIKES - 1) * TILE_SIZE + y] = 0xffffffff;
+    }
+    for (int y = 12; y < 16; ++y) {
+        bits[(GRASS - 1) * TILE_SIZE + y] = 0xffff;
+    }
+    bounds[GROUND - 1] = (SDL_Rect){0, 16, 32, 16};
+    bounds[SPIKES - 1] = (SDL_Rect){0, 8, 32, 8};
+    bounds[GRASS - 1] = (SDL_Rect){0, 12, 16, 4};
+}
+
+void AppendLayer(char* json, int id, char* name, int tile, int x0, int x1) {
+    sprintf(
+        json + strlen(json),
+        "%s{\"id\":%d,\"name\":\"%s\",\"type\":\"tilelayer\",\"width\":%d,"
+        "\"height\":%d,\"x\":0,\"y\":0,\"opacity\":1,\"visible\":true,"
+        "\"data\":[",
+        id > 1 ? "," : "", id, name, MAP_W, MAP_H
+    );
+    for (int i = 0; i < MAP_W * MAP_H; ++i) {
+        int x = i % MAP_W, y = i / MAP_W;
+        int gid = y == 1 && x >= x0 && x <= x1 ? tile : 0;
+        sprintf(json + strlen(json), "%s%d", i > 0 ? "," : "", gid);
+    }
+    strcat(json, "]}");
+}
+
+/*
+  Ground lies under tiles 0 and 1 of the middle row, with grass over tile 0
+  and spikes over tile 1. Tiles 3 to 5 are flipped. Each kind of tile is on
+  its own middle layer.
+*/
+Map* LoadTestMap() {
+    static char json[16384];
+    sprintf(
+        json,
+        "{\"width\":%d,\"height\":%d,\"tilewidth\":%d,\"tileheight\":%d,"
+        "\"orientation\":\"orthogonal\",\"renderorder\":\"right-down\","
+        "\"infinite\":false,\"layers\":[",
+        MAP_W, MAP_H, TILE_SIZE, TILE_SIZE
+    );
+    AppendLayer(json, 1, "middle", GROUND, 0, 1);
+    AppendLayer(json, 2, "middle_grass", GRASS, 0, 0);
+    AppendLayer(json, 3, "middle_spikes", SPIKES, 1, 1);
+    AppendLayer(json, 4, "middle_diagonal", GROUND | FLIP_DIAGONAL, 3, 3);
+    AppendLayer(json, 5, "middle_vertical", GROUND | FLIP_VERTICAL, 4, 4);
+    AppendLayer(
+        json, 6, "middle_both", GRASS | FLIP_DIAGONAL | FLIP_VERTICAL, 5, 5
+    );
+    // cute_tiled reads an integer property up to the next comma, so it must
+    // not be the last one
+    sprintf(
+        json + strlen(json),
+        "],\"tilesets\":[{\"firstgid\":1,\"name\":\"terrains\","
+        "\"image\":\"terrains.png\",\"imagewidth\":%d,\"imageheight\":%d,"
+        "\"tilewidth\":%d,\"tileheight\":%d,\"tilecount\":3,\"columns\":3,"
+        "\"margin\":0,\"spacing\":0,\"tiles\":[{\"id\":%d,\"properties\":["
+        "{\"name\":\"damage\",\"type\":\"int\",\"value\":10},"
+        "{\"name\":\"has_damage\",\"type\":\"bool\",\"value\":true}]}]}]}",
+        3 * TILE_SIZE, TILE_SIZE, TILE_SIZE, TILE_SIZE, SPIKES - 1
+    );
+    return LoadMapFromMem(json, strlen(json));
+}
+
+int IsEmpty(Map* map, float x, float y, float w, float h) {
+    return MapIsEmpty(map, &(SDL_FRect){x, y, w, h});
+}
+
+int GetDamage(Map* map, float x, float y, float w, float h) {
+    return MapHasDamage(map, &(SDL_FRect){x, y, w, h});
+}
+
+void TestStackedTiles(Map* map) {
+    // the spikes hurt, but do not take away the ground under them
+    CHECK(!IsEmpty(map, 36, 52, 8, 8));
+    CHECK(GetDamage(map, 36, 41, 8, 4) == 10);
+    CHECK(IsEmpty(map, 36, 41, 8, 4));
+    CHECK(IsEmpty(map, 36, 32, 8, 6));
+    // grass and ground add up to one shape
+    CHECK(!IsEmpty(map, 2, 45, 4, 2));
+    CHECK(IsEmpty(map, 20, 45, 4, 2));
+    CHECK(!IsEmpty(map, 20, 52, 4, 4));
+    CHECK(GetDamage(map, 0, 32, 32, 32) == 0);
+    // rays go through the spikes and stop on the ground
+    RaycastHit hit;
+    CHECK(MapRaycast(map, (Vector2f){48, 2}, (Vector2f){0, 1}, 100, &hit));
+    CHECK(hit.tile.x == 1 && hit.tile.y == 1);
+    CHECK(SDL_fabsf(hit.point.y - 48) < 0.01f);
+}
+
+void TestFlippedTiles(Map* map) {
+    // flipped along its diagonal, ground fills the right half of the tile
+    CHECK(IsEmpty(map, 96, 32, 16, 32));
+    CHECK(!IsEmpty(map, 112, 32, 4, 4));
+    CHECK(!IsEmpty(map, 124, 60, 4, 4));
+    // flipped vertically, it fills the upper half
+    CHECK(!IsEmpty(map, 128, 32, 4, 4));
+    CHECK(IsEmpty(map, 128, 48, 32, 16));
+    // grass is first turned into columns 12 to 15, then moved down
+    CHECK(!IsEmpty(map, 172, 48, 4, 16));
+    CHECK(IsEmpty(map, 172, 32, 4, 16));
+    CHECK(IsEmpty(map, 160, 32, 12, 32));
+    CHECK(IsEmpty(map, 176, 32, 16, 32));
+    RaycastHit hit;
+    CHECK(MapRaycast(map, (Vector2f){96, 40}, (Vector2f){1, 0}, 64, &hit));
+    CHECK(hit.tile.x == 3 && SDL_fabsf(hit.point.x - 112) < 0.01f);
+}
+
+void TestSetMapTile(Map* map) {
+    CHECK(SetMapTile(map, "middle", 1, 1, 0));
+    CHECK(IsEmpty(map, 36, 52, 8, 8));
+    CHECK(GetDamage(map, 36, 41, 8, 4) == 10);
+    CHECK(SetMapTile(map, "middle_spikes", 1, 1, 0));
+    CHECK(GetDamage(map, 36, 41, 8, 4) == 0);
+    CHECK(SetMapTile(map, "middle", 1, 1, GROUND));
+    CHECK(!IsEmpty(map, 36, 52, 8, 8));
+    CHECK(!SetMapTile(map, "middle", MAP_W, 0, GROUND));
+    CHECK(!SetMapTile(map, "no_such_layer", 0, 0, GROUND));
+}
+
+void TestDirtyRegion(Map* map) {
+    DirtyRegion* dirty = &map->dirty.middle;
+    dirty->count = 0;
+    SetMapTile(map, "middle", 0, 2, GROUND);
+    SetMapTile(map, "middle", MAP_W - 1, 2, GROUND);
+    // edits far apart are not merged into one rectangle across the map
+    CHECK(dirty->count == 2);
+    SetMapTile(map, "middle", 1, 2, GROUND);
+    CHECK(dirty->count == 2);
+    CHECK(SDL_RectEquals(&dirty->rects[0], &(SDL_Rect){0, 2, 2, 1}));
+    CHECK(SDL_RectEquals(&dirty->rects[1], &(SDL_Rect){MAP_W - 1, 2, 1, 1}));
+    // the region never grows beyond its capacity
+    for (int x = 3; x < MAP_W; x += 3) {
+        SetMapTile(map, "middle", x, 0, GROUND);
+    }
+    CHECK(dirty->count <= MAX_DIRTY_RECTS);
+    for (int x = 3; x < MAP_W; x += 3) {
+        int is_covered = 0;
+        for (int i = 0; i < dirty->count; ++i) {
+            SDL_Point tile = {x, 0};
+            is_covered |= SDL_PointInRect(&tile, &dirty->rects[i]);
+        }
+        CHECK(is_covered);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    TileMask mask;
+    uint64_t bits[3 * TILE_SIZE];
+    SDL_Rect bounds[3];
+    CreateTestMask(&mask, bits, bounds);
+    terrains_mask = &mask;
+    Map* map = LoadTestMap();
+    CHECK(map != NULL);
+    if (map) {
+        TestStackedTiles(map);
+        TestFlippedTiles(map);
+        TestSetMapTile(map);
+        TestDirtyRegion(map);
+        FreeMap(map);
+    }
+    terrains_mask = NULL;
+    return test_failures != 0;
+}
@@ -0,0 +1,124 @@
+/*
+  Copyright (c) 2025 zhengxyz123
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "map.h"
+#include "navigation.h"
+#include "test.h"
+#include <string.h>
+
+#define MAP_W 20
+#define MAP_H 8
+#define TILE_SIZE 32
+
+#define GROUND 1
+
+/*
+  Ground along the bottom row with a hole from tile 8 to 11, which can be
+  jumped over. Without a mask every tile is solid as a whole.
+*/
+Map* LoadTestMap() {
+    static char json[8192];
+    sprintf(
+        json,
+        "{\"width\":%d,\"height\":%d,\"tilewidth\":%d,\"tileheight\":%d,"
+        "\"orientation\":\"orthogonal\",\"renderorder\":\"right-down\","
+        "\"infinite\":false,\"layers\":[{\"id\":1,\"name\":\"middle\","
+        "\"type\":\"tilelayer\",\"width\":%d,\"height\":%d,\"x\":0,\"y\":0,"
+        "\"opacity\":1,\"visible\":true,\"data\":[",
+        MAP_W, MAP_H, TILE_SIZE, TILE_SIZE, MAP_W, MAP_H
+    );
+    for (int i = 0; i < MAP_W * MAP_H; ++i) {
+        int x = i % MAP_W, y = i / MAP_W;
+        int gid = y == MAP_H - 1 && (x < 8 || x > 11) ? GROUND : 0;
+        sprintf(json + strlen(json), "%s%d", i > 0 ? "," : "", gid);
+    }
+    sprintf(
+        json + strlen(json),
+        "]}],\"tilesets\":[{\"firstgid\":1,\"name\":\"terrains\","
+        "\"image\":\"terrains.png\",\"imagewidth\":%d,\"imageheight\":%d,"
+        "\"tilewidth\":%d,\"tileheight\":%d,\"tilecount\":1,\"columns\":1,"
+        "\"margin\":0,\"spacing\":0}]}",
+        TILE_SIZE, TILE_SIZE, TILE_SIZE, TILE_SIZE
+    );
+    return LoadMapFromMem(json, strlen(json));
+}
+
+int HasNavEdge(NavGraph* graph, NavSpan* span, NavEdge* edge) {
+    for (int i = 0; i < span->edge_count; ++i) {
+        NavEdge* other = &graph->edges[span->first_edge + i];
+        if (other->type == edge->type && other->to == edge->to &&
+            other->from_x == edge->from_x && other->to_x == edge->to_x &&
+            other->cost == edge->cost) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+  After each edit, the graph updated around the changed tile must have the
+  same spans and edges as a graph built from scratch.
+*/
+void TestUpdateNavGraph(Map* map) {
+    int edits[][3] = {
+        {9, 5, GROUND},  {9, 5, 0},      {10, 6, GROUND}, {16, 2, GROUND},
+        {4, 5, GROUND},  {10, 6, 0},     {3, 6, GROUND},  {9, 7, GROUND},
+        {4, 5, 0},       {13, 4, GROUND}
+    };
+    for (int i = 0; i < SDL_arraysize(edits); ++i) {
+        SetMapTile(map, "middle", edits[i][0], edits[i][1], edits[i][2]);
+        CHECK(map->nav->is_dirty);
+        // a query brings the graph up to date
+        FindNavPath(map, (Vector2f){16, 224}, (Vector2f){16, 224});
+        NavGraph* graph = map->nav;
+        NavGraph* fresh = CreateNavGraph(map);
+        CHECK(!graph->is_dirty);
+        CHECK(graph->span_count == fresh->span_count);
+        CHECK(graph->edge_count == fresh->edge_count);
+        for (int j = 0; j < SDL_min(graph->span_count, fresh->span_count);
+             ++j) {
+            NavSpan* span = &graph->spans[j];
+            NavSpan* fresh_span = &fresh->spans[j];
+            CHECK(span->y == fresh_span->y && span->x0 == fresh_span->x0);
+            CHECK(span->edge_count == fresh_span->edge_count);
+            for (int k = 0; k < span->edge_count; ++k) {
+                NavEdge* edge = &graph->edges[span->first_edge + k];
+                CHECK(HasNavEdge(fresh, fresh_span, edge));
+            }
+        }
+        FreeNavGraph(fresh);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Map* map = LoadTestMap();
+    CHECK(map != NULL);
+    if (map) {
+        NavPath* path =
+            FindNavPath(map, (Vector2f){16, 224}, (Vector2f){624, 224});
+        // walk to the hole, jump over it and walk on
+        CHECK(path && path->count == 2 && path->steps[0].type == NAV_EDGE_JUMP);
+        TestUpdateNavGraph(map);
+        FreeMap(map);
+    }
+    return test_failures != 0;
+}
@@ -28,11 +28,14 @@ value is array of byte.
 import argparse
 import json
 import os
+import struct
 import subprocess
 import tempfile
 import ctypes
 import shutil
 import sys
+import xml.etree.ElementTree as ET
+import zlib
 from io import BytesIO
 from pathlib import Path
 
@@ -59,6 +62,18 @@ class RespackEntry(ctypes.LittleEndianStructure):
     ]
 
 
+class TileMaskHeader(ctypes.LittleEndianStructure):
+    _pack_ = 8
+    _fields_ = [
+        ("magic", ctypes.c_char * 4),
+        ("version", ctypes.c_uint8),
+        ("tile_width", ctypes.c_uint16),
+        ("tile_height", ctypes.c_uint16),
+        ("tile_count", ctypes.c_uint16),
+        ("words_per_row", ctypes.c_uint16),
+    ]
+
+
 def _fnv1a_32(s: str) -> int:
     hval = 2166136261
     for c in s:
@@ -143,6 +158,103 @@ def loads(b: bytes) -> dict[str, bytes]:
     return result
 
 
+def _read_png_alpha(path: Path) -> tuple[int, int, bytes]:
+    """Read the alpha channel of a non-interlaced 8-bit PNG image."""
+    data = path.read_bytes()
+    if data[:8] != b"\x89PNG\r\n\x1a\n":
+        raise ValueError(f"{str(path)!r} is not a PNG image")
+    pos = 8
+    idat = b""
+    palette_alpha = b""
+    while pos < len(data):
+        (length,) = struct.unpack(">I", data[pos : pos + 4])
+        chunk_type = data[pos + 4 : pos + 8]
+        chunk = data[pos + 8 : pos + 8 + length]
+        if chunk_type == b"IHDR":
+            width, height, depth, color_type, _, _, interlace = struct.unpack(
+                ">IIBBBBB", chunk
+            )
+        elif chunk_type == b"tRNS":
+            palette_alpha = chunk
+        elif chunk_type == b"IDAT":
+            idat += chunk
+        pos += 12 + length
+    if depth != 8 or interlace != 0:
+        raise ValueError(f"{str(path)!r} must be a non-interlaced 8-bit image")
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[color_type]
+    stride = width * channels
+    raw = zlib.decompress(idat)
+    pixels = bytearray()
+    prev = bytearray(stride)
+    for y in range(height):
+        filter_type = raw[y * (stride + 1)]
+        line = bytearray(raw[y * (stride + 1) + 1 : (y + 1) * (stride + 1)])
+        for x in range(stride):
+            a = line[x - channels] if x >= channels else 0
+            b = prev[x]
+            c = prev[x - channels] if x >= channels else 0
+            if filter_type == 1:
+                line[x] = (line[x] + a) & 0xFF
+            elif filter_type == 2:
+                line[x] = (line[x] + b) & 0xFF
+            elif filter_type == 3:
+                line[x] = (line[x] + (a + b) // 2) & 0xFF
+            elif filter_type == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                pred = a if pa <= pb and pa <= pc else (b if pb <= pc else c)
+                line[x] = (line[x] + pred) & 0xFF
+        pixels += line
+        prev = line
+    if color_type in (4, 6):
+        alpha = bytes(pixels[channels - 1 :: channels])
+    elif color_type == 3:
+        alpha = bytes(
+            palette_alpha[i] if i < len(palette_alpha) else 255 for i in pixels
+        )
+    else:
+        alpha = b"\xff" * (width * height)
+    return width, height, alpha
+
+
+def _make_tile_masks(tsx_path: Path) -> tuple[str, bytes]:
+    """Make 1-bit-per-pixel collision masks for every tile of a tileset.
+
+    The masks are taken from the alpha channel of the tileset image, or of the
+    image given by the `collision_mask` tileset property if it exists. Each
+    row of a tile is stored as little-endian 64-bit words, bit `i` of word `w`
+    is pixel `64 * w + i`.
+
+    Returns the mask image path relative to `tsx_path` and the mask data.
+    """
+    tileset = ET.parse(tsx_path).getroot()
+    tile_w = int(tileset.get("tilewidth"))
+    tile_h = int(tileset.get("tileheight"))
+    tile_count = int(tileset.get("tilecount"))
+    columns = int(tileset.get("columns"))
+    image_source = tileset.find("image").get("source")
+    mask_source = image_source
+    for prop in tileset.findall("properties/property"):
+        if prop.get("name") == "collision_mask":
+            mask_source = prop.get("value")
+    width, _, alpha = _read_png_alpha(tsx_path.parent / mask_source)
+    words_per_row = (tile_w + 63) // 64
+
+    buf = BytesIO()
+    buf.write(TileMaskHeader(b"TMSK", 1, tile_w, tile_h, tile_count, words_per_row))
+    for tile in range(tile_count):
+        x0 = tile % columns * tile_w
+        y0 = tile // columns * tile_h
+        for y in range(tile_h):
+            row = 0
+            for x in range(tile_w):
+                if alpha[(y0 + y) * width + x0 + x] >= 128:
+                    row |= 1 << x
+            for w in range(words_per_row):
+                buf.write(struct.pack("<Q", (row >> (64 * w)) & (2**64 - 1)))
+    return str(Path(image_source).with_suffix(".mask")), buf.getvalue()
+
+
 def _subcmd_gen(args: argparse.Namespace) -> int:
     if shutil.which("tiled") is None:
         raise RuntimeError("tiled must be installed")
@@ -159,7 +271,11 @@ def _subcmd_gen(args: argparse.Namespace) -> int:
     for root, _, files in Path(args.src).walk():
         for file in files:
             key = (root / file).relative_to(Path(args.src))
-            if key.match("*.tsx") or key.match("*.tiled-session"):
+            if key.match("*.tsx"):
+                mask_path, value = _make_tile_masks(root / file)
+                obj[str((key.parent / mask_path).as_posix())] = value
+                continue
+            elif key.match("*.tiled-session"):
                 continue
             elif args.psp and key.match("*.ttc"):
                 continue